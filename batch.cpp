@@ -0,0 +1,301 @@
+#include <QtWidgets/QApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+#include <QDir>
+#include <QLoggingCategory>
+
+#include "loadtrace.h"
+#include "results.h"
+#include "summaries.h"
+#include "spectrum.h"
+#include "resample.h"
+#include "samples.h"
+#include "report.h"
+#include "correlate.h"
+#include "warehouse.h"
+#include "stream.h"
+#include "window.h"
+#include "rules.h"
+#include "batch.h"
+
+#include "sql/connection.h"
+
+/*
+    Processing without the user interface, e.g.
+
+        procvib --batch <dir> --output results.csv
+        procvib --batch <dir> --column wMax --top 50 --from "2019-07-29 00:00:00"
+        procvib --batch <dir> --column RMS --percent 1 --per-period
+        procvib --batch <dir> --column wMax --percentile 95
+        procvib --batch <dir> --column wMax --top 200 --report events.pdf
+        procvib --batch <dir1> --correlate <dir2> --correlate <dir3> --refine
+        procvib --batch <dir> --store
+        procvib --batch <dir> --stream --output results.csv
+        procvib --batch <dir> --rules working-hours.rules
+        procvib --rollups daily --from "2019-01-01 00:00:00"
+*/
+
+bool isBatchRun(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i ++)
+    {
+        if (QString(argv[i]) == "--batch" || QString(argv[i]) == "--rollups")
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void writeRanked(QTextStream &out, t_SummaryColumn col, const t_RankedList &ranked)
+{
+    out << "File name,Date/time," << SummaryColumnNames[col] << ",Percent rank,Excluded?" << "\n";
+    foreach (const t_Ranked &r, ranked)
+    {
+        t_Trace * p_t = getTrace(r.trace);
+        out << p_t->fileName
+            << "," << p_t->dt.toString("dd/MM/yyyy HH:mm:ss")
+            << "," << QString::number(static_cast<qreal>(r.value))
+            << "," << QString::number(r.percentRank, 'f', 2)
+            << ",";
+        if (p_t->exclusion > 0)
+        {
+            out << "X";
+        }
+        out << "\n";
+    }
+}
+
+int runBatch(int argc, char *argv[])
+{
+    // No display is needed (or wanted) for a batch run
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication a(argc, argv);
+    connectionMessageBoxes() = false;
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("batch", "Process all the .CSV files in <dir>.", "dir"));
+    parser.addOption(QCommandLineOption("output", "Write to <file> rather than standard output.", "file"));
+    parser.addOption(QCommandLineOption("column", "Column to rank by: Max, RMS, wMax, 4thPower or maxAxis.", "name", "wMax"));
+    parser.addOption(QCommandLineOption("top", "Only the <k> largest values.", "k"));
+    parser.addOption(QCommandLineOption("percent", "Only the largest <p> percent of values.", "p"));
+    parser.addOption(QCommandLineOption("percentile", "Only the value of the column below which <p> percent of values lie.", "p"));
+    parser.addOption(QCommandLineOption("per-period", "Apply --percent within each day/night VDV period."));
+    parser.addOption(QCommandLineOption("from", "Only traces at or after <datetime> (yyyy-MM-dd HH:mm:ss, UTC).", "datetime"));
+    parser.addOption(QCommandLineOption("to", "Only traces at or before <datetime>.", "datetime"));
+    parser.addOption(QCommandLineOption("include-excluded", "Include excluded traces in rankings."));
+    parser.addOption(QCommandLineOption("report", "Also plot the events (the ranked ones, if ranking) to <path>: a .pdf file, or a directory of PNGs.", "path"));
+    parser.addOption(QCommandLineOption("report-min", "Only report events with a windowed max of at least <value>.", "value", "0"));
+    parser.addOption(QCommandLineOption("correlate", "Correlate the events of <dir> with those of the --batch directory. Can be repeated.", "dir"));
+    parser.addOption(QCommandLineOption("tolerance", "Events within <s> seconds are the same event, when correlating.", "s", "2"));
+    parser.addOption(QCommandLineOption("refine", "Refine correlated arrival times from the RMS envelopes."));
+    parser.addOption(QCommandLineOption("resample", "Resample every file to <hz> before processing.", "hz"));
+    parser.addOption(QCommandLineOption("compact", "Hold the samples as integers, in about half the memory but slower to process."));
+    parser.addOption(QCommandLineOption("window", "Window for the windowed max: blackman, hann or flattop.", "shape", "blackman"));
+    parser.addOption(QCommandLineOption("window-time", "Length of the window, in <s> (0.176 s is 22 samples at 125 Hz).", "s", "0.176"));
+    parser.addOption(QCommandLineOption("rules", "Exclude the traces matched by the rules in <file>, recording them in Exclude.sqlite (not with --stream or --correlate).", "file"));
+    parser.addOption(QCommandLineOption("stream", "Write the full results in one pass, without keeping the samples in memory."));
+    parser.addOption(QCommandLineOption("warehouse", "Use <file> as the results warehouse.", "file"));
+    parser.addOption(QCommandLineOption("store", "Add the results to the warehouse."));
+    parser.addOption(QCommandLineOption("profile", "Report timings, such as the rate files are read at, on standard error."));
+    parser.addOption(QCommandLineOption("rollups", "Write the <daily> or <weekly> rollups from the warehouse (--from/--to apply).", "period"));
+    parser.process(a);
+
+    if (parser.isSet("profile"))
+    {
+        QLoggingCategory::setFilterRules("procvib.profile.info=true");
+    }
+
+    QDir dir(parser.value("batch"));
+
+    QFile file;
+    if (parser.isSet("output"))
+    {
+        file.setFileName(parser.value("output"));
+        if (!file.open(QFile::WriteOnly))
+        {
+            qWarning("Cannot write %s: %s", qPrintable(parser.value("output")), qPrintable(file.errorString()));
+            return 1;
+        }
+    }
+    else
+    {
+        file.open(stdout, QFile::WriteOnly);
+    }
+    QTextStream out(&file);
+
+    if (parser.isSet("store") || parser.isSet("rollups"))
+    {
+        QString path = parser.isSet("warehouse") ? parser.value("warehouse") : defaultWarehousePath();
+        if (!openWarehouse(path))
+        {
+            qWarning("Cannot open the warehouse %s", qPrintable(path));
+            return 1;
+        }
+    }
+
+    if (parser.isSet("rollups"))
+    {
+        QDateTime from = QDateTime::fromString(parser.value("from"), "yyyy-MM-dd HH:mm:ss");
+        from.setTimeSpec(Qt::UTC);
+        QDateTime to = QDateTime::fromString(parser.value("to"), "yyyy-MM-dd HH:mm:ss");
+        to.setTimeSpec(Qt::UTC);
+        return exportRollups(out, parser.value("rollups") == "weekly", from, to) ? 0 : 1;
+    }
+
+    int shape = windowShapeFromName(parser.value("window"));
+    if (shape < 0)
+    {
+        QStringList names;
+        for (int w = 0; w < NumWindowShapes; w ++)
+        {
+            names << WindowShapeNames[w];
+        }
+        qWarning("Unknown --window %s, expected one of: %s", qPrintable(parser.value("window")), qPrintable(names.join(", ")));
+        return 1;
+    }
+    bool ok = false;
+    qreal seconds = parser.value("window-time").toDouble(&ok);
+    if (!ok || seconds <= 0.)
+    {
+        qWarning("Bad --window-time %s, expected a length in seconds", qPrintable(parser.value("window-time")));
+        return 1;
+    }
+    setWindow(static_cast<t_WindowShape>(shape), seconds);
+
+    if (parser.isSet("resample"))
+    {
+        setResampleFrequency(parser.value("resample").toFloat());
+    }
+
+    setCompactSamples(parser.isSet("compact"));
+
+    if (parser.isSet("rules") && (parser.isSet("correlate") || parser.isSet("stream")))
+    {
+        qWarning("--rules can't be used with --correlate or --stream");
+        return 1;
+    }
+
+    if (parser.isSet("correlate"))
+    {
+        QStringList dirs = QStringList() << parser.value("batch") << parser.values("correlate");
+        QStringList names;
+        QVector<t_DeviceEvents> devices;
+        for (int d = 0; d < dirs.size(); d ++)
+        {
+            names << QDir(dirs.at(d)).dirName();
+            devices.push_back(deviceEvents(QDir(dirs.at(d)), d));
+        }
+        writeCorrelated(out, correlateEvents(devices, parser.value("tolerance").toDouble(), parser.isSet("refine")), names);
+        return 0;
+    }
+
+    if (parser.isSet("stream"))
+    {
+        return streamResults(dir, out, true) ? 0 : 1;
+    }
+
+    t_ExclusionRules rules;
+    if (parser.isSet("rules"))
+    {
+        QString error;
+        if (!loadExclusionRules(parser.value("rules"), rules, error))
+        {
+            qWarning("%s", qPrintable(error));
+            return 1;
+        }
+    }
+
+    loadtrace(dir, QList<QFileInfo>());
+    processExclusions(dir);
+    addWindowedMax();
+    t_VDVs vs = postProcessVdv();
+    if (parser.isSet("rules"))
+    {
+        // Rules can test wMax, so they're matched once it's known. The events and
+        // VDV periods of the traces they exclude are worked out again.
+        applyExclusionRules(dir, rules);
+        vs = currentVdv();
+    }
+    addSpectra(0);
+    storeInWarehouse(dir, 0);
+
+    if (!parser.isSet("top") && !parser.isSet("percent") && !parser.isSet("percentile"))
+    {
+        writeResults(out, true);
+        if (parser.isSet("report"))
+        {
+            return writeReport(parser.value("report"), significantEvents(parser.value("report-min").toFloat())) ? 0 : 1;
+        }
+        return 0;
+    }
+
+    int col = summaryColumnFromName(parser.value("column"));
+    if (col < 0)
+    {
+        QStringList names;
+        for (int c = 0; c < NumSummaryColumns; c ++)
+        {
+            names << SummaryColumnNames[c];
+        }
+        qWarning("Unknown --column %s, expected one of: %s", qPrintable(parser.value("column")), qPrintable(names.join(", ")));
+        return 1;
+    }
+
+    t_TraceFilter filter;
+    if (parser.isSet("from"))
+    {
+        filter.from = QDateTime::fromString(parser.value("from"), "yyyy-MM-dd HH:mm:ss");
+        filter.from.setTimeSpec(Qt::UTC);
+    }
+    if (parser.isSet("to"))
+    {
+        filter.to = QDateTime::fromString(parser.value("to"), "yyyy-MM-dd HH:mm:ss");
+        filter.to.setTimeSpec(Qt::UTC);
+    }
+    filter.includeExcluded = parser.isSet("include-excluded");
+
+    if (parser.isSet("percentile"))
+    {
+        qreal p = parser.value("percentile").toDouble();
+        out << "Column,Percentile,Value" << "\n";
+        out << SummaryColumnNames[col] << "," << p << "," << percentileOf(static_cast<t_SummaryColumn>(col), p, filter) << "\n";
+        return 0;
+    }
+
+    t_RankedList ranked;
+    if (parser.isSet("top"))
+    {
+        ranked = topK(static_cast<t_SummaryColumn>(col), parser.value("top").toInt(), filter);
+    }
+    else if (parser.isSet("per-period"))
+    {
+        ranked = topPercentPerPeriod(static_cast<t_SummaryColumn>(col), parser.value("percent").toDouble(), filter, vs);
+    }
+    else
+    {
+        ranked = topPercent(static_cast<t_SummaryColumn>(col), parser.value("percent").toDouble(), filter);
+    }
+    writeRanked(out, static_cast<t_SummaryColumn>(col), ranked);
+
+    if (parser.isSet("report"))
+    {
+        QVector<int> events;
+        foreach (const t_Ranked &r, ranked)
+        {
+            int base = eventStart(r.trace);
+            if (!events.contains(base))
+            {
+                events.push_back(base);
+            }
+        }
+        return writeReport(parser.value("report"), events) ? 0 : 1;
+    }
+
+    return 0;
+}
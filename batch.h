@@ -0,0 +1,7 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+extern bool isBatchRun(int argc, char *argv[]);
+extern int  runBatch(int argc, char *argv[]);
+
+#endif // BATCH_H
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <queue>
+#include <vector>
+
+#include <QtMath>
+
+#include "loadtrace.h"
+#include "correlate.h"
+
+// Load one device's directory and reduce it to its (non-excluded) events, in time order.
+t_DeviceEvents deviceEvents(QDir dir, int device)
+{
+    loadtrace(dir, QList<QFileInfo>());
+    processExclusions(dir);
+    addWindowedMax();
+
+    t_DeviceEvents events;
+    t_Trace * p_t;
+    for (int i = 0; (p_t = getTrace(i)) != nullptr; i = eventEnd(i))
+    {
+        // As windowedMaxOfEvent(): an event with any excluded trace doesn't count
+        bool isExcluded = false;
+        for (int end = eventEnd(i), j = i; j < end; j ++)
+        {
+            if (getTrace(j)->exclusion > 0)
+            {
+                isExcluded = true;
+            }
+        }
+        if (isExcluded)
+            continue;
+
+        t_DeviceEvent e;
+        e.time = p_t->dt.toMSecsSinceEpoch();
+        e.amplitude = p_t->wMax;    // the same measure for every device
+        e.frequency = p_t->frequency;
+        e.device = device;
+        e.fileName = p_t->fileName;
+        e.envelope = ValsToRms(*p_t);
+        events.push_back(e);
+    }
+
+    // Files are read in name order, which is nearly always time order
+    std::stable_sort(events.begin(), events.end(), [](const t_DeviceEvent &a, const t_DeviceEvent &b) { return a.time < b.time; });
+    return events;
+}
+
+// Lag (s) of b's envelope behind a's that best lines them up, searched over +/- maxLag seconds
+static qreal envelopeLag(const t_DeviceEvent &a, const t_DeviceEvent &b, qreal maxLag)
+{
+    const QVector<qreal> &x = a.envelope;
+    const QVector<qreal> &y = b.envelope;
+    if (x.isEmpty() || y.isEmpty() || a.frequency != b.frequency)
+        return 0.;
+
+    qreal xMean = 0., yMean = 0.;
+    foreach (qreal v, x) xMean += v;
+    foreach (qreal v, y) yMean += v;
+    xMean /= x.size();
+    yMean /= y.size();
+
+    int lags = qMin(static_cast<int>(maxLag*static_cast<qreal>(a.frequency)), qMin(x.size(), y.size())/2);
+    qreal best = -1.e99;
+    int bestLag = 0;
+    for (int l = -lags; l <= lags; l ++)
+    {
+        qreal c = 0.;
+        for (int i = qMax(0, -l), end = qMin(x.size(), y.size() - l); i < end; i ++)
+        {
+            c += (x.at(i) - xMean)*(y.at(i + l) - yMean);
+        }
+        if (c > best)
+        {
+            best = c;
+            bestLag = l;
+        }
+    }
+    return static_cast<qreal>(bestLag)/static_cast<qreal>(a.frequency);
+}
+
+// Merge the time-ordered event lists of all devices (a k-way merge, so
+// O(E log N) for E events from N devices), and group events from different
+// devices that start within "tolerance" seconds of the group's first event.
+t_CorrelatedEvents correlateEvents(const QVector<t_DeviceEvents> &devices, qreal tolerance, bool refine)
+{
+    typedef std::pair<qint64, std::pair<int,int>> t_Head;     // time, (device, index)
+    std::priority_queue<t_Head, std::vector<t_Head>, std::greater<t_Head>> heads;
+    for (int d = 0; d < devices.size(); d ++)
+    {
+        if (!devices.at(d).isEmpty())
+        {
+            heads.push(t_Head(devices.at(d).first().time, std::make_pair(d, 0)));
+        }
+    }
+
+    qint64 toleranceMs = static_cast<qint64>(tolerance*1000.);
+    t_CorrelatedEvents res;
+    t_CorrelatedEvent group;
+    QVector<bool> inGroup(devices.size(), false);
+
+    auto finishGroup = [&]()
+    {
+        if (group.members.size() > 1)
+        {
+            const t_DeviceEvent &ref = group.members.first();
+            for (int m = 0; m < group.members.size(); m ++)
+            {
+                const t_DeviceEvent &e = group.members.at(m);
+                qreal offset = static_cast<qreal>(e.time - ref.time)/1000.;
+                if (refine && m > 0)
+                {
+                    offset += envelopeLag(ref, e, tolerance);
+                }
+                group.offset.push_back(offset);
+                group.ratio.push_back((ref.amplitude > 0.0f) ? static_cast<qreal>(e.amplitude/ref.amplitude) : 0.);
+            }
+            res.push_back(group);
+        }
+        group = t_CorrelatedEvent();
+        inGroup.fill(false);
+    };
+
+    while (!heads.empty())
+    {
+        t_Head h = heads.top();
+        heads.pop();
+        int d = h.second.first;
+        int i = h.second.second;
+        const t_DeviceEvent &e = devices.at(d).at(i);
+
+        // A device can only be in a group once; a second event from it starts a new group
+        if (!group.members.isEmpty() && (e.time - group.members.first().time > toleranceMs || inGroup.at(d)))
+        {
+            finishGroup();
+        }
+        group.members.push_back(e);
+        inGroup[d] = true;
+
+        if (i + 1 < devices.at(d).size())
+        {
+            heads.push(t_Head(devices.at(d).at(i + 1).time, std::make_pair(d, i + 1)));
+        }
+    }
+    finishGroup();
+
+    return res;
+}
+
+void writeCorrelated(QTextStream &out, const t_CorrelatedEvents &events, const QStringList &deviceNames)
+{
+    out << "Event,Device,File name,Date/time,Windowed Max.,Offset [s],Amplitude ratio" << "\n";
+    for (int n = 0; n < events.size(); n ++)
+    {
+        const t_CorrelatedEvent &c = events.at(n);
+        for (int m = 0; m < c.members.size(); m ++)
+        {
+            const t_DeviceEvent &e = c.members.at(m);
+            out << (n + 1)
+                << "," << deviceNames.value(e.device)
+                << "," << e.fileName
+                << "," << QDateTime::fromMSecsSinceEpoch(e.time, Qt::UTC).toString("dd/MM/yyyy HH:mm:ss")
+                << "," << QString::number(static_cast<qreal>(e.amplitude))
+                << "," << QString::number(c.offset.at(m), 'f', 3)
+                << "," << QString::number(c.ratio.at(m), 'f', 3) << "\n";
+        }
+    }
+}
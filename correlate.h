@@ -0,0 +1,40 @@
+#ifndef CORRELATE_H
+#define CORRELATE_H
+
+#include <QDir>
+#include <QList>
+#include <QTextStream>
+#include <QVector>
+
+// One event as seen by one device. Only what's needed for correlation is kept,
+// so that many devices' worth of events fit in memory.
+class t_DeviceEvent
+{
+public:
+    qint64  time;           // ms since epoch, UTC, of the first sample
+    float   amplitude;      // windowed max (or max, without one)
+    float   frequency;      // of the envelope
+    int     device;
+    QString fileName;
+    QVector<qreal> envelope;    // RMS envelope of the first trace, see ValsToRms()
+};
+
+typedef QVector<t_DeviceEvent> t_DeviceEvents;
+
+// An event seen by more than one device. The first member is the reference
+// that the offsets and ratios are relative to.
+class t_CorrelatedEvent
+{
+public:
+    QVector<t_DeviceEvent> members;
+    QVector<qreal> offset;      // s, arrival time relative to the reference
+    QVector<qreal> ratio;       // amplitude relative to the reference
+};
+
+typedef QVector<t_CorrelatedEvent> t_CorrelatedEvents;
+
+extern t_DeviceEvents deviceEvents(QDir dir, int device);
+extern t_CorrelatedEvents correlateEvents(const QVector<t_DeviceEvents> &devices, qreal tolerance, bool refine);
+extern void writeCorrelated(QTextStream &out, const t_CorrelatedEvents &events, const QStringList &deviceNames);
+
+#endif // CORRELATE_H
@@ -0,0 +1,304 @@
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "distributions.h"
+
+static const qreal SmallestValue = 1.e-3;  // measurement units
+static const int   MaxBuckets = 2048;     // 1% accuracy covers 1.e-3 .. 1.e14 in that many
+static const int   TracesPerChunk = 4096;
+
+t_QuantileSketch::t_QuantileSketch(qreal relativeAccuracy)
+{
+    gamma = (1. + relativeAccuracy)/(1. - relativeAccuracy);
+    logGamma = std::log(gamma);
+    offset = 0;
+    small = 0;
+    total = 0;
+}
+
+int t_QuantileSketch::bucketOf(qreal x) const
+{
+    return static_cast<int>(std::ceil(std::log(x)/logGamma));
+}
+
+// Make room for "bucket". Beyond MaxBuckets, the lowest buckets are folded
+// together, so only the smallest values lose accuracy.
+void t_QuantileSketch::grow(int bucket)
+{
+    if (counts.isEmpty())
+    {
+        offset = bucket;
+        counts.resize(1);
+        return;
+    }
+    if (bucket < offset)
+    {
+        counts.insert(0, offset - bucket, 0);
+        offset = bucket;
+    }
+    else if (bucket >= offset + counts.size())
+    {
+        counts.resize(bucket - offset + 1);
+    }
+    if (counts.size() > MaxBuckets)
+    {
+        int fold = counts.size() - MaxBuckets;
+        quint64 folded = 0;
+        for (int i = 0; i <= fold; i ++)
+        {
+            folded += counts.at(i);
+        }
+        counts.remove(0, fold);
+        counts[0] = folded;
+        offset += fold;
+    }
+}
+
+void t_QuantileSketch::add(qreal x)
+{
+    total ++;
+    if (!(x > SmallestValue))
+    {
+        small ++;
+        return;
+    }
+    int b = bucketOf(x);
+    grow(b);
+    counts[qMax(b, offset) - offset] ++;
+}
+
+void t_QuantileSketch::merge(const t_QuantileSketch &other)
+{
+    Q_ASSERT(gamma == other.gamma);
+    if (!other.counts.isEmpty())
+    {
+        grow(other.offset);
+        grow(other.offset + other.counts.size() - 1);
+        for (int i = 0; i < other.counts.size(); i ++)
+        {
+            counts[qMax(other.offset + i, offset) - offset] += other.counts.at(i);
+        }
+    }
+    small += other.small;
+    total += other.total;
+}
+
+qreal t_QuantileSketch::quantile(qreal q) const
+{
+    if (total == 0)
+        return 0.;
+
+    quint64 rank = static_cast<quint64>(q*static_cast<qreal>(total - 1));
+    quint64 seen = small;
+    if (rank < seen)
+        return 0.;
+    for (int i = 0; i < counts.size(); i ++)
+    {
+        seen += counts.at(i);
+        if (rank < seen)
+        {
+            return 2.*std::pow(gamma, offset + i)/(gamma + 1.);    // middle of the bucket, in relative terms
+        }
+    }
+    return 2.*std::pow(gamma, offset + counts.size() - 1)/(gamma + 1.);
+}
+
+t_LogHistogram::t_LogHistogram(qreal lowest, int binsPerDecade, int bins)
+    : lowest(lowest), binsPerDecade(binsPerDecade), counts(bins + 2, 0)
+{
+}
+
+void t_LogHistogram::add(qreal x)
+{
+    int bin = 0;
+    if (x >= lowest)
+    {
+        bin = 1 + static_cast<int>(std::floor(binsPerDecade*std::log10(x/lowest)));
+        bin = qMin(bin, counts.size() - 1);
+    }
+    counts[bin] ++;
+}
+
+void t_LogHistogram::merge(const t_LogHistogram &other)
+{
+    Q_ASSERT(counts.size() == other.counts.size());
+    for (int i = 0; i < counts.size(); i ++)
+    {
+        counts[i] += other.counts.at(i);
+    }
+}
+
+qreal t_LogHistogram::lower(int bin) const
+{
+    return (bin == 0) ? 0. : lowest*std::pow(10., static_cast<qreal>(bin - 1)/binsPerDecade);
+}
+
+qreal t_LogHistogram::upper(int bin) const
+{
+    return (bin == counts.size() - 1) ? std::numeric_limits<qreal>::infinity()
+                                      : lowest*std::pow(10., static_cast<qreal>(bin)/binsPerDecade);
+}
+
+void t_Distribution::merge(const t_Distribution &other)
+{
+    rms.merge(other.rms);
+    wMax.merge(other.wMax);
+    events.merge(other.events);
+}
+
+t_Distribution &t_Distributions::periodOf(const QDateTime &dt)
+{
+    QDateTime start, end;
+    vdvPeriodBounds(dt, start, end);
+    qint64 key = start.toSecsSinceEpoch();
+    if (!periods.contains(key))
+    {
+        t_Distribution &d = periods[key];
+        d.start = start;
+        d.end = end;
+    }
+    return periods[key];
+}
+
+t_Distribution &t_Distributions::dayOf(const QDateTime &dt)
+{
+    QDateTime start(dt.date(), QTime(0, 0, 0), Qt::UTC);
+    qint64 key = start.toSecsSinceEpoch();
+    if (!days.contains(key))
+    {
+        t_Distribution &d = days[key];
+        d.start = start;
+        d.end = start.addDays(1);
+    }
+    return days[key];
+}
+
+void t_Distributions::addTrace(const t_Trace &trace)
+{
+    if (trace.exclusion > 0)
+        return;
+    periodOf(trace.dt).rms.add(static_cast<qreal>(trace.rmsDeviation));
+    dayOf(trace.dt).rms.add(static_cast<qreal>(trace.rmsDeviation));
+}
+
+void t_Distributions::addEvent(const t_Trace &base)
+{
+    if (!(base.wMax > 0.0f))    // excluded, or not calculated
+        return;
+    t_Distribution &p = periodOf(base.dt);
+    p.wMax.add(static_cast<qreal>(base.wMax));
+    p.events.add(static_cast<qreal>(base.wMax));
+    t_Distribution &d = dayOf(base.dt);
+    d.wMax.add(static_cast<qreal>(base.wMax));
+    d.events.add(static_cast<qreal>(base.wMax));
+}
+
+static void mergeInto(QMap<qint64, t_Distribution> &to, const QMap<qint64, t_Distribution> &from)
+{
+    for (QMap<qint64, t_Distribution>::const_iterator it = from.constBegin(); it != from.constEnd(); ++ it)
+    {
+        if (to.contains(it.key()))
+        {
+            to[it.key()].merge(it.value());
+        }
+        else
+        {
+            to.insert(it.key(), it.value());
+        }
+    }
+}
+
+void t_Distributions::merge(const t_Distributions &other)
+{
+    mergeInto(periods, other.periods);
+    mergeInto(days, other.days);
+}
+
+// The distributions of the loaded traces. Ranges of traces are done over the
+// thread pool, and merged.
+t_Distributions distributionsOf(void)
+{
+    QVector<int> firsts;
+    for (int i = 0; getTrace(i) != nullptr; i += TracesPerChunk)
+    {
+        firsts.push_back(i);
+    }
+
+    std::function<t_Distributions(const int &)> chunk = [](const int &first)
+    {
+        t_Distributions d;
+        t_Trace * p_t;
+        for (int i = first; i < first + TracesPerChunk && (p_t = getTrace(i)) != nullptr; i ++)
+        {
+            d.addTrace(*p_t);
+            if (i == 0 || !(p_t->dt < getTrace(i - 1)->dt.addSecs(6)))   // first trace of an event
+            {
+                d.addEvent(*p_t);
+            }
+        }
+        return d;
+    };
+    std::function<void(t_Distributions &, const t_Distributions &)> merge = [](t_Distributions &result, const t_Distributions &d)
+    {
+        result.merge(d);
+    };
+    return QtConcurrent::blockingMappedReduced<t_Distributions>(firsts, chunk, merge);
+}
+
+static void writeQuantiles(QTextStream &out, const t_Distribution &d)
+{
+    const qreal quantiles[4] = {0.5, 0.9, 0.95, 0.99};
+    out << d.start.toString("dd/MM/yyyy HH:mm:ss")
+        << "," << d.end.toString("dd/MM/yyyy HH:mm:ss")
+        << "," << d.rms.count();
+    for (int k = 0; k < 4; k ++)
+    {
+        out << "," << QString::number(d.rms.quantile(quantiles[k]));
+    }
+    out << "," << d.wMax.count();
+    for (int k = 0; k < 4; k ++)
+    {
+        out << "," << QString::number(d.wMax.quantile(quantiles[k]));
+    }
+    out << "\n";
+}
+
+// Percentiles per VDV period and per day, then the number of events in each
+// band of windowed max per VDV period. Percentiles are within 1%.
+void writeDistributions(QTextStream &out, const t_Distributions &d)
+{
+    const char * const header = "Start,End,Traces,RMS 50%,RMS 90%,RMS 95%,RMS 99%,"
+                                "Events,Windowed Max. 50%,Windowed Max. 90%,Windowed Max. 95%,Windowed Max. 99%";
+    out << header << "\n";
+    foreach (const t_Distribution &p, d.periods)
+    {
+        writeQuantiles(out, p);
+    }
+    out << header << "\n";
+    foreach (const t_Distribution &p, d.days)
+    {
+        writeQuantiles(out, p);
+    }
+
+    out << "Start,End,Windowed Max. from,Windowed Max. to,Events" << "\n";
+    foreach (const t_Distribution &p, d.periods)
+    {
+        for (int bin = 0; bin < p.events.size(); bin ++)
+        {
+            if (p.events.count(bin) == 0)
+                continue;
+            out << p.start.toString("dd/MM/yyyy HH:mm:ss")
+                << "," << p.end.toString("dd/MM/yyyy HH:mm:ss")
+                << "," << QString::number(p.events.lower(bin))
+                << ",";
+            if (bin < p.events.size() - 1)
+            {
+                out << QString::number(p.events.upper(bin));
+            }
+            out << "," << p.events.count(bin) << "\n";
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef DISTRIBUTIONS_H
+#define DISTRIBUTIONS_H
+
+#include <QDateTime>
+#include <QMap>
+#include <QTextStream>
+#include <QVector>
+
+#include "loadtrace.h"
+
+// Quantiles of a stream of positive values to within a relative accuracy, in
+// logarithmic buckets (as DDSketch). Sketches with the same accuracy can be
+// merged, and the result doesn't depend on the order values were added in.
+class t_QuantileSketch
+{
+public:
+    explicit t_QuantileSketch(qreal relativeAccuracy = 0.01);
+
+    void add(qreal x);
+    void merge(const t_QuantileSketch &other);
+    qreal quantile(qreal q) const;      // q from 0 to 1. 0 if empty.
+    quint64 count(void) const { return total; }
+
+private:
+    int bucketOf(qreal x) const;
+    void grow(int bucket);
+
+    qreal gamma;
+    qreal logGamma;
+    int   offset;               // bucket of counts[0]
+    QVector<quint64> counts;
+    quint64 small;              // values too small for a bucket
+    quint64 total;
+};
+
+// Counts of values in logarithmic bins, binsPerDecade to a decade from
+// "lowest". The first bin is everything below that, the last everything above.
+class t_LogHistogram
+{
+public:
+    t_LogHistogram(qreal lowest = 10., int binsPerDecade = 4, int bins = 20);
+
+    void add(qreal x);
+    void merge(const t_LogHistogram &other);
+    int size(void) const { return counts.size(); }
+    qreal lower(int bin) const;         // 0 for the first bin
+    qreal upper(int bin) const;         // infinity for the last bin
+    quint64 count(int bin) const { return counts.at(bin); }
+
+private:
+    qreal lowest;
+    int   binsPerDecade;
+    QVector<quint64> counts;
+};
+
+// Distributions over one period: the RMS of each trace and the windowed max
+// of each event, leaving out excluded ones
+class t_Distribution
+{
+public:
+    QDateTime start;
+    QDateTime end;
+    t_QuantileSketch rms;
+    t_QuantileSketch wMax;
+    t_LogHistogram   events;     // by windowed max
+
+    void merge(const t_Distribution &other);
+};
+
+// Distributions per VDV period and per day (UTC), keyed by start in s since epoch
+class t_Distributions
+{
+public:
+    void addTrace(const t_Trace &trace);
+    void addEvent(const t_Trace &base);     // the first trace of an event, holding its windowed max
+    void merge(const t_Distributions &other);
+
+    QMap<qint64, t_Distribution> periods;
+    QMap<qint64, t_Distribution> days;
+
+private:
+    t_Distribution &periodOf(const QDateTime &dt);
+    t_Distribution &dayOf(const QDateTime &dt);
+};
+
+extern t_Distributions distributionsOf(void);
+extern void writeDistributions(QTextStream &out, const t_Distributions &d);
+
+#endif // DISTRIBUTIONS_H
@@ -0,0 +1,138 @@
+#include <algorithm>
+
+#include <QSettings>
+#include <QStringList>
+#include <QtMath>
+
+#include "exceedance.h"
+
+static t_ExceedanceScanner Scanner;
+
+t_ExceedanceScanner &getExceedanceScanner(void)
+{
+    return Scanner;
+}
+
+// Levels are read from "Exceedance.ini" in the data directory, if there is one:
+//    [Exceedance]
+//    thresholds=163.84,327.68,819.2
+//    hysteresis=10
+// otherwise 10, 20 and 50 mg are used.
+t_ExceedanceLevels loadExceedanceLevels(QDir dir)
+{
+    QSettings settings(dir.filePath("Exceedance.ini"), QSettings::IniFormat);
+    QStringList thresholds = settings.value("Exceedance/thresholds", QStringList() << "163.84" << "327.68" << "819.2").toStringList();
+    float hysteresis = settings.value("Exceedance/hysteresis", 10.0).toFloat();
+
+    t_ExceedanceLevels levels;
+    foreach (QString s, thresholds)
+    {
+        bool ok;
+        t_ExceedanceLevel l;
+        l.threshold = s.toFloat(&ok);
+        l.hysteresis = hysteresis;
+        if (ok && l.threshold > 0.0f)
+        {
+            levels.push_back(l);
+        }
+    }
+    std::sort(levels.begin(), levels.end(), [](const t_ExceedanceLevel &a, const t_ExceedanceLevel &b) { return a.threshold < b.threshold; });
+    return levels;
+}
+
+void t_ExceedanceScanner::setLevels(const t_ExceedanceLevels &levels)
+{
+    theLevels = levels;
+    on_sq.clear();
+    off_sq.clear();
+    lowest_sq = 1.e99;
+
+    // Compare squared deviations in g, as they come out of the statistics loop,
+    // so no square root is needed per sample.
+    foreach (t_ExceedanceLevel l, theLevels)
+    {
+        qreal on = static_cast<qreal>(l.threshold)/16384.;
+        qreal off = qMax(0., static_cast<qreal>(l.threshold - l.hysteresis)/16384.);
+        on_sq.push_back(on*on);
+        off_sq.push_back(off*off);
+        if (on*on < lowest_sq)
+            lowest_sq = on*on;
+    }
+
+    start.fill(-1, ExcNumChannels*theLevels.size());
+    peak_sq.fill(0., ExcNumChannels*theLevels.size());
+    for (int ch = 0; ch < ExcNumChannels; ch ++)
+    {
+        activeCount[ch] = 0;
+    }
+    activeTotal = 0;
+}
+
+void t_ExceedanceScanner::begin(int trace)
+{
+    theTrace = trace;
+}
+
+// Exceedances still going at the end of the trace last until its end.
+void t_ExceedanceScanner::end(int samples)
+{
+    if (activeTotal == 0)
+        return;
+    for (int ch = 0; ch < ExcNumChannels; ch ++)
+    {
+        for (int end = theLevels.size(), l = 0; l < end && activeCount[ch] > 0; l ++)
+        {
+            if (start.at(ch*end + l) >= 0)
+            {
+                close(ch, l, samples);
+            }
+        }
+    }
+}
+
+void t_ExceedanceScanner::scanChannel(int i, int ch, qreal sq)
+{
+    for (int end = theLevels.size(), l = 0; l < end; l ++)
+    {
+        int k = ch*end + l;
+        if (start.at(k) < 0)
+        {
+            if (sq >= on_sq.at(l))
+            {
+                start[k] = i;
+                peak_sq[k] = sq;
+                activeCount[ch] ++;
+                activeTotal ++;
+            }
+        }
+        else
+        {
+            if (sq > peak_sq.at(k))
+            {
+                peak_sq[k] = sq;
+            }
+            if (sq < off_sq.at(l))
+            {
+                close(ch, l, i);
+            }
+        }
+    }
+}
+
+void t_ExceedanceScanner::close(int ch, int level, int endSample)
+{
+    int k = ch*theLevels.size() + level;
+
+    t_Exceedance e;
+    e.trace = theTrace;
+    e.startSample = start.at(k);
+    e.samples = endSample - start.at(k);
+    e.peak = 16384.0f*static_cast<float>(qSqrt(peak_sq.at(k)));
+    e.channel = static_cast<quint8>(ch);
+    e.level = static_cast<quint8>(level);
+    found.push_back(e);
+
+    start[k] = -1;
+    activeCount[ch] --;
+    activeTotal --;
+}
@@ -0,0 +1,100 @@
+#ifndef EXCEEDANCE_H
+#define EXCEEDANCE_H
+
+#include <QDir>
+#include <QVector>
+#include <QDateTime>
+
+// Channels that are checked against the thresholds
+typedef enum
+{
+    ExcX = 0,
+    ExcY = 1,
+    ExcZ = 2,
+    ExcVector = 3,      // vector sum of the three axes
+    ExcNumChannels = 4
+} t_ExceedanceChannel;
+
+// An exceedance starts when a deviation reaches "threshold", and ends when it
+// drops below "threshold - hysteresis". Both in measurement units, as the Max. column.
+class t_ExceedanceLevel
+{
+public:
+    float threshold;
+    float hysteresis;
+};
+
+typedef QVector<t_ExceedanceLevel> t_ExceedanceLevels;
+
+class t_Exceedance
+{
+public:
+    int     trace;          // index of the trace
+    int     startSample;    // first sample at or above the threshold
+    int     samples;        // duration
+    float   peak;           // largest deviation during the exceedance
+    quint8  channel;        // t_ExceedanceChannel
+    quint8  level;          // index into the levels
+
+    QDateTime startTime(const QDateTime &traceStart, float frequency) const
+    {
+        return traceStart.addMSecs(qRound64(1000.0*startSample/static_cast<qreal>(frequency)));
+    }
+};
+
+typedef QVector<t_Exceedance> t_Exceedances;
+
+// Checks the samples of one trace at a time against every level, on every
+// channel. It is fed from the loop that calculates the trace statistics, so the
+// samples are only gone through once.
+class t_ExceedanceScanner
+{
+public:
+    void setLevels(const t_ExceedanceLevels &levels);
+    const t_ExceedanceLevels &levels(void) const { return theLevels; }
+
+    void begin(int trace);
+    void end(int samples);
+
+    // Squared deviations of X, Y, Z and their sum, in g^2. The sum is at least as
+    // large as each axis, so while it's below every threshold and nothing is
+    // going on, one comparison does for the sample.
+    inline void sample(int i, const qreal *sq)
+    {
+        if (sq[ExcVector] < lowest_sq && activeTotal == 0)
+            return;
+        for (int ch = 0; ch < ExcNumChannels; ch ++)
+        {
+            // Nearly all samples are below every threshold
+            if (sq[ch] >= lowest_sq || activeCount[ch] > 0)
+            {
+                scanChannel(i, ch, sq[ch]);
+            }
+        }
+    }
+
+    void clear(void) { found.clear(); }
+    const t_Exceedances &exceedances(void) const { return found; }
+
+private:
+    void scanChannel(int i, int ch, qreal sq);
+    void close(int ch, int level, int endSample);
+
+    t_ExceedanceLevels theLevels;
+    QVector<qreal>  on_sq;          // per level, squared thresholds in g^2
+    QVector<qreal>  off_sq;
+    qreal           lowest_sq = 1.e99;
+
+    int             theTrace = -1;
+    QVector<int>    start;          // per channel and level, -1 if not in an exceedance
+    QVector<qreal>  peak_sq;
+    int             activeCount[ExcNumChannels] = {0, 0, 0, 0};
+    int             activeTotal = 0;    // over all channels
+
+    t_Exceedances   found;
+};
+
+extern t_ExceedanceScanner &getExceedanceScanner(void);
+extern t_ExceedanceLevels loadExceedanceLevels(QDir dir);
+
+#endif // EXCEEDANCE_H
@@ -1,3 +1,4 @@
+#include <cstring>
 #include <vector>
 
 #include <QString>
@@ -7,15 +8,47 @@
 #include <QDir>
 #include <QTextStream>
 #include <QtMath>
+#include <QMap>
+#include <QSet>
+#include <QElapsedTimer>
 
 #include <QSqlQueryModel>
 
 #include "loadtrace.h"
+#include "telemetry.h"
+#include "exceedance.h"
+#include "summaries.h"
+#include "resample.h"
+#include "quality.h"
+#include "window.h"
+#include "readahead.h"
+#include "timeline.h"
 
 #include "sql/connection.h"
 
 static t_Traces Traces;
-static t_Extras Extras;
+static t_Telemetry Telemetry;   // heartbeat and ON records
+static t_VDVs   Vdvs;     // running sums per period, see addVdv()
+static QMap<QString, t_FileState> FileStates;   // keyed by absolute file path
+static t_Resamplers Resamplers;                 // of the current load
+
+// Dependencies of derived values on individual traces: the event (identified by
+// the index of its first trace) whose windowed max the trace contributes to, and
+// the VDV period it contributes to. Only as long as the traces that have been
+// processed so far.
+static QVector<int> EventOfTrace;
+static QVector<int> VdvOfTrace;
+
+// While streaming (see loadtraceStreaming()), traces and extras are handed to
+// the sink instead of being stored.
+static t_Sink * Sink = nullptr;
+static int      SunkTraces = 0;
+static bool     SinkHasExclusions = false;
+
+int traceCount(void)
+{
+    return Traces.size();
+}
 
 t_Trace *getTrace(int index)
 {
@@ -29,245 +62,401 @@ t_Trace *getTrace(int index)
     }
 }
 
-t_Extra *getExtra(int index)
+bool getExtra(int index, t_Extra &extra)
 {
-    if (index < Extras.size())
+    if (index < Telemetry.size())
     {
-        return &Extras[index];
+        extra = Telemetry.at(index);
+        return true;
     }
     else
     {
-        return nullptr;
+        return false;
     }
 }
 
-void processExclusions(QDir dir)
+const t_Telemetry &getTelemetry(void)
 {
-    if (!createConnection(dir))
-        return;
+    return Telemetry;
+}
 
-    for(int end = Traces.size(), i = 0; i < end; i ++)
+// Exclusion class of a trace, from the Exclude.sqlite connection that is open.
+// Traces that aren't in it may be excluded because of their quality.
+static uint exclusionOf(const t_Trace &trace)
+{
+    QSqlQuery query;
+    query.prepare("select id, exclusion from trace where (filename=:filename and datetime=:datetime)");
+    query.bindValue(":filename", trace.fileName);
+    query.bindValue(":datetime", trace.dt.toSecsSinceEpoch());
+    query.exec();
+    if (query.first())
     {
-        QSqlQuery query;
-        query.prepare("select id, exclusion from trace where (filename=:filename and datetime=:datetime)");
-        query.bindValue(":filename", Traces[i].fileName);
-        query.bindValue(":datetime", Traces[i].dt.toSecsSinceEpoch());
-        query.exec();
-        if (query.first())
-        {
-            Traces[i].exclusion = query.value(1).toUInt();
-        }
-        else
-        {
-            Traces[i].exclusion = 0;
-        }
+        return query.value(1).toUInt();
+    }
+    else if (trace.quality & getQualityLimits().autoExclude)
+    {
+        return QualityExclusion;
+    }
+    else
+    {
+        return 0;
     }
 }
 
-static QVector<qreal> makeBlackmanWindow(void)
+void processExclusions(QDir dir, int first)
 {
-    QVector<qreal> res;
-    int M = 22;
+    if (!createConnection(dir))
+        return;
 
-    for (int i = 1; i < M; i ++)   // 1 .. (M-1).  Outside that, is zero
+    invalidateSummaries();
+    for(int end = Traces.size(), i = first; i < end; i ++)
     {
-        qreal iM = 2*M_PI*static_cast<qreal>(i)/static_cast<qreal>(M);
-        res.push_back(   0.42
-                        -0.50*qCos(iM)
-                        +0.08*qCos(2*iM) );
+        Traces[i].exclusion = exclusionOf(Traces.at(i));
     }
-    return res;
-}
-
-static qreal BlackmanWindowSum(void)
-{
-    // The sum of the window shape above
-    return 9.2400;
 }
 
 // Change a 3-dimensional trace to a 1-dimensional one
-static QVector<qreal> ValsToRms(std::vector<std::array<float,3>> in)
+QVector<qreal> ValsToRms(const t_Trace &trace)
 {
     QVector<qreal> out;
+    out.reserve(static_cast<int>(sampleCount(trace)));
     qreal x_avg, y_avg, z_avg;
     x_avg = y_avg = z_avg = 0.0;
-    for(int end = in.size(), i = 0; i < end; i ++)
+    forEachSample(trace, [&](float x, float y, float z)
     {
-        x_avg += in.at(i).at(0);
-        y_avg += in.at(i).at(1);
-        z_avg += in.at(i).at(2);
-    }
-    x_avg /= static_cast<qreal>(in.size());
-    y_avg /= static_cast<qreal>(in.size());
-    z_avg /= static_cast<qreal>(in.size());
-    for(int end = in.size(), i = 0; i < end; i ++)
+        x_avg += x;
+        y_avg += y;
+        z_avg += z;
+    });
+    x_avg /= static_cast<qreal>(sampleCount(trace));
+    y_avg /= static_cast<qreal>(sampleCount(trace));
+    z_avg /= static_cast<qreal>(sampleCount(trace));
+    forEachSample(trace, [&](float x, float y, float z)
     {
-        out.push_back( qSqrt(qPow(in.at(i).at(0)-x_avg, 2) + qPow(in.at(i).at(1)-y_avg, 2) + qPow(in.at(i).at(2)-z_avg, 2) )  );
-    }
+        out.push_back( qSqrt(qPow(x-x_avg, 2) + qPow(y-y_avg, 2) + qPow(z-z_avg, 2) )  );
+    });
+    return out;
+}
+
+size_t sampleCount(const t_Trace &trace)
+{
+    if (!trace.packed.narrow.empty())
+        return trace.packed.narrow.size();
+    return trace.vals.size();
+}
+
+// One axis of a trace, normalised to g
+std::vector<float> axisSamples(const t_Trace &trace, int axis)
+{
+    std::vector<float> out;
+    out.reserve(sampleCount(trace));
+    forEachSample(trace, [&](float x, float y, float z)
+    {
+        out.push_back((axis == 0) ? x : (axis == 1) ? y : z);
+    });
     return out;
 }
 
-static qreal convolve(QVector<qreal> longer, QVector<qreal> shorter, int offset)
+// Windowed peak of a single trace, normalised by the window's sum (see window.h).
+// Cached in the trace, as it only depends on the trace's own samples.
+qreal traceWindowedPeak(t_Trace &trace)
 {
-    qreal tot = 0.;
-    for(int end = shorter.size(), i = 0; i < end; i ++)
+    if (trace.wPeak < 0.)
     {
-        tot += shorter.at(i)*longer.at(i + offset);
+        trace.wPeak = windowedPeakOf(ValsToRms(trace), trace.frequency);
     }
-    return tot;
+    return trace.wPeak;
 }
 
-void addWindowedMax(void)
+// Windowed max of an event, from the largest windowed peak of its traces
+float windowedMaxFromPeak(qreal peak)
 {
-    QVector<qreal> theWindow = makeBlackmanWindow();
+    return 16384.0f*static_cast<float>(1.414213562 * peak);  // Scale by 16384 to change it back into measurement units.
+                                                             // Scale by SQRT(2) to account for RMS.
+}
 
-    int latestBase = -1;
+// Calculate the windowed maximum of the event starting at trace "base", and store
+// it in that trace. Returns the index of the trace after the end of the event.
+static int windowedMaxOfEvent(int base)
+{
     bool isExcluded = false;
     qreal latestTot = 0.;
-    QDateTime lastTime = QDateTime(); // invalid
+    int i = base;
 
-    for(int end = Traces.size(), i = 0; i < end; i ++)
+    EventOfTrace.resize(Traces.size());
+    do
     {
-        if (lastTime.isValid() && Traces.at(i).dt < lastTime.addSecs(6))
-        {
-            // This is not sufficiently long after the previous trace -- probably part of the same event.
-
-        }
-        else
-        {
-            // A new event. Push the old one.
-            if (latestBase >= 0 && !isExcluded)
-            {
-                t_Trace &newT = Traces[latestBase];
-                newT.wMax = 16384.0f*static_cast<float>(1.414213562 * latestTot / BlackmanWindowSum());  // Scale by 16384 to change it back into measurement units.
-                                                                                            // Scale by SQRT(2) to account for RMS.
-            }
-
-            latestBase = i;
-            latestTot = 0.;
-            isExcluded = false;
-        }
-
-        lastTime = Traces.at(i).dt;
-
+        EventOfTrace[i] = base;
         if (Traces.at(i).exclusion > 0)
         {
             isExcluded = true;
         }
 
-        if (isExcluded)
+        if (!isExcluded)
         {
-            // do nothing
-        }
-        else
-        {
-            // Calculate the maximum
-            int j = 0;
-            QVector<qreal> valsrms = ValsToRms(Traces.at(i).vals);
-            qreal max_y = -99999.;
-            for (int end = valsrms.size() - theWindow.size() + 1; j < end; j ++)
+            qreal y = traceWindowedPeak(Traces[i]);
+            if (y > latestTot)
             {
-                qreal y = convolve(valsrms, theWindow, j);
-                if (y > max_y)
-                {
-                    max_y = y;
-                }
-            }
-
-            if (max_y > latestTot)
-            {
-                latestTot = max_y;
+                latestTot = y;
             }
         }
+        i ++;
+    } while (i < Traces.size() && Traces.at(i).dt < Traces.at(i - 1).dt.addSecs(6));   // not sufficiently long after the previous trace -- part of the same event.
+
+    t_Trace &newT = Traces[base];
+    if (isExcluded)
+    {
+        newT.wMax = 0.;
+    }
+    else
+    {
+        newT.wMax = windowedMaxFromPeak(latestTot);
     }
+    updateSummary(base);
+    updateTimeline(base);
+    return i;
+}
 
-    // Push the final value.
-    if (latestBase >= 0 && !isExcluded)
+// Index of the first trace of the event that trace "index" is part of.
+int eventStart(int index)
+{
+    while (index > 0 && Traces.at(index).dt < Traces.at(index - 1).dt.addSecs(6))
     {
-        t_Trace &newT = Traces[latestBase];
-        newT.wMax = 16384.0f*static_cast<float>(1.414213562 * latestTot / BlackmanWindowSum());  // Scale by 16384 to change it back into measurement units.
-                                                                                                 // Scale by SQRT(2) to account for RMS.
+        index --;
     }
+    return index;
+}
 
+// Index of the trace after the end of the event starting at trace "base".
+int eventEnd(int base)
+{
+    int i = base + 1;
+    while (i < Traces.size() && Traces.at(i).dt < Traces.at(i - 1).dt.addSecs(6))
+    {
+        i ++;
+    }
+    return i;
 }
 
-t_VDVs postProcessVdv(void)
+void addWindowedMax(void)
+{
+    for(int i = 0; i < Traces.size(); )
+    {
+        i = windowedMaxOfEvent(i);
+    }
+}
+
+// Recalculate windowed maximums after traces have been appended from index
+// "first". Only the event the first new trace belongs to, and later ones, are affected.
+void updateWindowedMax(int first)
+{
+    for(int i = eventStart(first); i < Traces.size(); )
+    {
+        i = windowedMaxOfEvent(i);
+    }
+}
+
+// Start and end of the VDV period that dt falls in.
+void vdvPeriodBounds(QDateTime dt, QDateTime &dt_start, QDateTime &dt_end)
 {
-    t_VDVs vs;
     // Day is 7AM - 11 PM
     // Night is 11 PM - 7AM.
     const int morning_hour = 7;
     const int evening_hour = 23;
 
-    for(int endi = Traces.size(), i = 0; i < endi; i ++)
+    dt_start = dt;
+    dt_end = dt;
+    int h = dt_start.time().hour();
+    if (h >= 0 && h < morning_hour)
+    {
+        dt_end.setTime(QTime(morning_hour, 0, 0));
+        dt_start = dt_end.addDays(-1);
+        dt_start.setTime(QTime(evening_hour, 0, 0));
+    }
+    else if (h < evening_hour)
+    {
+        dt_start.setTime(QTime(morning_hour, 0, 0));
+        dt_end.setTime(QTime(evening_hour, 0, 0));
+    }
+    else
     {
-        QDateTime dt_start = Traces.at(i).dt;
-        int j, endj;
-        for (endj = vs.size(), j = 0; j < endj; j ++)
+        dt_start.setTime(QTime(evening_hour, 0, 0));
+        dt_end = dt_start.addDays(1);
+        dt_end.setTime(QTime(morning_hour, 0, 0));
+    }
+}
+
+// Find the VDV period containing dt, creating it if there is none yet.
+static int vdvPeriodOf(QDateTime dt)
+{
+    // Traces come mostly in time order, so nearly always it's the latest period
+    if (!Vdvs.isEmpty() && dt >= Vdvs.last().start && dt <= Vdvs.last().end)
+    {
+        return Vdvs.size() - 1;
+    }
+
+    for (int endj = Vdvs.size(), j = 0; j < endj; j ++)
+    {
+        if (dt >= Vdvs.at(j).start && dt <= Vdvs.at(j).end)
         {
-            if (dt_start >= vs.at(j).start && dt_start <= vs.at(j).end)
-            {
-                // This matches
-                vs[j].total_VDV += qPow(Traces.at(i).total4thPowerDeviation, 4.0);
-                break;
-            }
-        }
-        if (j >= endj)
-        {
-            // None matched
-            QDateTime dt_end = dt_start;
-            int h = dt_start.time().hour();
-            if (h >= 0 && h < morning_hour)
-            {
-                dt_end.setTime(QTime(morning_hour, 0, 0));
-                dt_start = dt_end.addDays(-1);
-                dt_start.setTime(QTime(evening_hour, 0, 0));
-            }
-            else if (h < evening_hour)
-            {
-                dt_start.setTime(QTime(morning_hour, 0, 0));
-                dt_end.setTime(QTime(evening_hour, 0, 0));
-            }
-            else
-            {
-                dt_start.setTime(QTime(evening_hour, 0, 0));
-                dt_end = dt_start.addDays(1);
-                dt_end.setTime(QTime(morning_hour, 0, 0));
-            }
-            t_VDV v;
-            v.start = dt_start;
-            v.end = dt_end;
-            v.total_VDV = qPow(Traces.at(i).total4thPowerDeviation, 4.0);
-            vs.push_back(v);
+            // This matches
+            return j;
         }
+    }
+
+    // None matched
+    QDateTime dt_start, dt_end;
+    vdvPeriodBounds(dt, dt_start, dt_end);
+    t_VDV v;
+    v.start = dt_start;
+    v.end = dt_end;
+    v.total_VDV = 0.;
+    v.sum_4thPower = 0.;
+    Vdvs.push_back(v);
+    return Vdvs.size() - 1;
+}
 
+// What a trace adds to the sum of its VDV period. Excluded traces add nothing.
+qreal vdvContribution(const t_Trace &trace)
+{
+    if (trace.exclusion == 0)
+    {
+        return qPow(static_cast<qreal>(trace.total4thPowerDeviation), 4.0);
     }
-    for (int endj = vs.size(), j = 0; j < endj; j ++)
+    return 0.;
+}
+
+// Add the traces from index "first" onwards into the running VDV sums. Excluded
+// traces are recorded as part of their period but contribute nothing.
+void addVdv(int first)
+{
+    VdvOfTrace.resize(Traces.size());
+    for(int endi = Traces.size(), i = first; i < endi; i ++)
     {
-        vs[j].total_VDV = qPow(vs[j].total_VDV, 0.25);
+        int j = vdvPeriodOf(Traces.at(i).dt);
+        VdvOfTrace[i] = j;
+        Vdvs[j].traces.push_back(i);
+        Vdvs[j].sum_4thPower += vdvContribution(Traces.at(i));
     }
+}
 
+// Add a trace that isn't kept into the running VDV sums (when streaming)
+void addTraceToVdv(const t_Trace &trace)
+{
+    Vdvs[vdvPeriodOf(trace.dt)].sum_4thPower += vdvContribution(trace);
+}
+
+// Recalculate the sum of one VDV period from its traces.
+static void recalculateVdv(int j)
+{
+    qreal sum = 0.;
+    foreach (int i, Vdvs.at(j).traces)
+    {
+        sum += vdvContribution(Traces.at(i));
+    }
+    Vdvs[j].sum_4thPower = sum;
+}
+
+t_VDVs currentVdv(void)
+{
+    t_VDVs vs = Vdvs;
+    for (int endj = vs.size(), j = 0; j < endj; j ++)
+    {
+        vs[j].total_VDV = static_cast<float>(qPow(vs[j].sum_4thPower, 0.25));
+    }
     return vs;
 }
 
+t_VDVs postProcessVdv(void)
+{
+    Vdvs.clear();
+    addVdv(0);
+    return currentVdv();
+}
+
+// Change the exclusion of one trace, and recalculate only the values that depend
+// on it: the windowed max of its event and the VDV of its period. Returns the
+// index of the trace that holds the event's windowed max, or -1 if unchanged.
+int setExclusion(int index, uint exclusion)
+{
+    if (index < 0 || index >= Traces.size())
+        return -1;
+
+    Traces[index].exclusion = exclusion;
+    updateSummary(index);
+
+    if (index < VdvOfTrace.size())
+    {
+        recalculateVdv(VdvOfTrace.at(index));
+    }
+
+    if (index < EventOfTrace.size())
+    {
+        int base = EventOfTrace.at(index);
+        windowedMaxOfEvent(base);
+        return base;
+    }
+    return -1;
+}
+
+// As setExclusion(), for many traces at once: each VDV period and event that holds
+// any of them is recalculated once, after all of the exclusions are set.
+void setExclusions(const QVector<int> &indexes, uint exclusion)
+{
+    QSet<int> periods;
+    QSet<int> events;
+    foreach (int index, indexes)
+    {
+        if (index < 0 || index >= Traces.size())
+            continue;
+
+        Traces[index].exclusion = exclusion;
+        updateSummary(index);
+        if (index < VdvOfTrace.size())
+        {
+            periods.insert(VdvOfTrace.at(index));
+        }
+        if (index < EventOfTrace.size())
+        {
+            events.insert(EventOfTrace.at(index));
+        }
+    }
+
+    foreach (int j, periods)
+    {
+        recalculateVdv(j);
+    }
+    foreach (int base, events)
+    {
+        windowedMaxOfEvent(base);
+    }
+}
+
 static void AddNewTrace(t_Trace &trace)
 {
-    unsigned int i;
     qreal x_sum=0., y_sum=0., z_sum=0.;
-    size_t max_i = trace.vals.size();
-    const qreal freq = 125.0;   // TODO: make this depend on the input
+    const qreal freq = static_cast<qreal>(trace.frequency);   // from the "F=" of the block header
 
-    trace.frequency = static_cast<float>(freq);
-    for(i = 0; i < max_i; i ++)
+    // Either pack the samples as read, or normalise them in place
+    if (compactSamples() && packSamples(trace.vals, trace.packed))
     {
-        trace.vals[i][0] = trace.vals[i][0] / 16384.0f;
-        trace.vals[i][1] = trace.vals[i][1] / 16384.0f;
-        trace.vals[i][2] = trace.vals[i][2] / 16384.0f;
+        std::vector<std::array<float,3>>().swap(trace.vals);
     }
-    for(i = 0; i < max_i; i ++)
+    else
     {
-        x_sum += static_cast<qreal>(trace.vals[i][0]); y_sum += static_cast<qreal>(trace.vals[i][1]); z_sum += static_cast<qreal>(trace.vals[i][2]);
+        for(size_t end = trace.vals.size(), i = 0; i < end; i ++)
+        {
+            trace.vals[i][0] = trace.vals[i][0] / 16384.0f;
+            trace.vals[i][1] = trace.vals[i][1] / 16384.0f;
+            trace.vals[i][2] = trace.vals[i][2] / 16384.0f;
+        }
     }
+    const size_t max_i = sampleCount(trace);
+
+    forEachSample(trace, [&](float x, float y, float z)
+    {
+        x_sum += static_cast<qreal>(x); y_sum += static_cast<qreal>(y); z_sum += static_cast<qreal>(z);
+    });
 
     qreal x_avg = x_sum/(static_cast<qreal>(max_i));
     qreal y_avg = y_sum/(static_cast<qreal>(max_i));
@@ -279,30 +468,38 @@ static void AddNewTrace(t_Trace &trace)
     qreal max_sq_dev_per_axis[3];
     max_sq_dev_per_axis[0] = 0.; max_sq_dev_per_axis[1] = 0.; max_sq_dev_per_axis[2] = 0.;
 
-    for(i = 0; i < max_i; i ++)
+    // Exceedances are found in the same pass as the statistics
+    t_ExceedanceScanner &scanner = getExceedanceScanner();
+    scanner.begin((Sink != nullptr) ? SunkTraces : Traces.size());
+
+    int i = 0;
+    forEachSample(trace, [&](float x, float y, float z)
     {
         qreal sq_dev = 0.;
-        qreal axis_sq_dev;
+        qreal axis_sq_dev[ExcNumChannels];
 
         // X axis
-        axis_sq_dev = qPow(static_cast<qreal>(trace.vals[i][0]) - x_avg, 2);
-        sq_dev += axis_sq_dev;
-        if (axis_sq_dev > max_sq_dev_per_axis[0])
-            max_sq_dev_per_axis[0] = axis_sq_dev;
+        axis_sq_dev[0] = qPow(static_cast<qreal>(x) - x_avg, 2);
+        sq_dev += axis_sq_dev[0];
+        if (axis_sq_dev[0] > max_sq_dev_per_axis[0])
+            max_sq_dev_per_axis[0] = axis_sq_dev[0];
 
 
         // Y axis
-        axis_sq_dev = qPow(static_cast<qreal>(trace.vals[i][1]) - y_avg, 2);
-        sq_dev += axis_sq_dev;
-        if (axis_sq_dev > max_sq_dev_per_axis[1])
-            max_sq_dev_per_axis[1] = axis_sq_dev;
+        axis_sq_dev[1] = qPow(static_cast<qreal>(y) - y_avg, 2);
+        sq_dev += axis_sq_dev[1];
+        if (axis_sq_dev[1] > max_sq_dev_per_axis[1])
+            max_sq_dev_per_axis[1] = axis_sq_dev[1];
 
 
         // Z axis
-        axis_sq_dev = qPow(static_cast<qreal>(trace.vals[i][2]) - z_avg, 2);
-        sq_dev += axis_sq_dev;
-        if (axis_sq_dev > max_sq_dev_per_axis[2])
-            max_sq_dev_per_axis[2] = axis_sq_dev;
+        axis_sq_dev[2] = qPow(static_cast<qreal>(z) - z_avg, 2);
+        sq_dev += axis_sq_dev[2];
+        if (axis_sq_dev[2] > max_sq_dev_per_axis[2])
+            max_sq_dev_per_axis[2] = axis_sq_dev[2];
+
+        axis_sq_dev[ExcVector] = sq_dev;
+        scanner.sample(i ++, axis_sq_dev);
 
 
         if (sq_dev > max_sq_dev)
@@ -311,7 +508,8 @@ static void AddNewTrace(t_Trace &trace)
         }
         sum_sq_dev += sq_dev;
         sum_4thpow += qPow(sq_dev, 2);
-    }
+    });
+    scanner.end(static_cast<int>(max_i));
 
     trace.maximumDeviation = 16384.0f*static_cast<float>(qSqrt(max_sq_dev));
     trace.rmsDeviation = 16384.0f*static_cast<float>(qSqrt(sum_sq_dev/static_cast<qreal>(max_i)));
@@ -340,8 +538,303 @@ static void AddNewTrace(t_Trace &trace)
         }
     }
     trace.wMax = 0.;
+    trace.wPeak = -1.;
+    trace.dominantFrequency = 0.0f;   // until addSpectrum()
+    for (int b = 0; b < 3; b ++)
+    {
+        trace.bandRms[b] = 0.0f;
+    }
 
-    Traces.push_back(trace);
+    if (Sink != nullptr)
+    {
+        trace.exclusion = SinkHasExclusions ? exclusionOf(trace) : 0;
+        Sink->trace(trace);
+        SunkTraces ++;
+    }
+    else
+    {
+        Traces.push_back(trace);
+        invalidateSummaries();      // the timeline is added to when it's next wanted
+    }
+}
+
+static void newFileState(t_FileState &state, QDateTime dt)
+{
+    state.offset = 0;
+    state.lastSize = -1;
+    state.lastGrowth = QDateTime();
+    state.dt = dt;
+    state.tracesInFile = 0;
+    state.frequency = 125.0f;   // if the file doesn't say
+    state.headerCount = -1;
+    state.v_bat = -1.0; state.temp_1 = -1.0; state.temp_2 = -1.0; state.temp_3 = -1.0;
+    state.xyz.clear();
+    state.blockSamples = 0;
+    state.modalSamples = 0;
+    state.blockLengths.clear();
+    state.lastTraceDt = QDateTime();
+    state.lastHeartbeat = QDateTime();
+    state.vbatBad = false;
+}
+
+// The quality checks of a file carry on from the file before it in the directory,
+// so a heartbeat gap or a repeated time across the change of file is still seen.
+static void carryQuality(t_FileState &state, const t_FileState &previous)
+{
+    state.lastTraceDt = previous.lastTraceDt;
+    state.lastHeartbeat = previous.lastHeartbeat;
+    state.vbatBad = previous.vbatBad;
+}
+
+// The file state that has seen the latest trace, or nullptr if there is none
+static const t_FileState *latestFileState(void)
+{
+    const t_FileState *latest = nullptr;
+    for (QMap<QString, t_FileState>::const_iterator it = FileStates.constBegin(); it != FileStates.constEnd(); ++ it)
+    {
+        if (it.value().lastTraceDt.isValid() && (latest == nullptr || latest->lastTraceDt < it.value().lastTraceDt))
+        {
+            latest = &it.value();
+        }
+    }
+    return latest;
+}
+
+// Make a trace from the block of samples collected so far, if any.
+static void flushBlock(t_FileState &state, QString fileName)
+{
+    if (state.xyz.size() > 0)
+    {
+        t_Trace Trace;
+        Trace.isOn = false;
+        Trace.isHeartbeat = false;
+        Trace.dt = state.dt;
+        Trace.vals = state.xyz;
+        Trace.indexInFile = state.tracesInFile;
+        Trace.fileName = fileName;
+        Trace.frequency = state.frequency;
+        Trace.headerCount = state.headerCount;
+        Trace.quality = checkSamples(Trace.vals, getQualityLimits())
+                      | checkBlock(state, static_cast<int>(Trace.vals.size()), getQualityLimits());
+        state.xyz.clear();
+        state.headerCount = -1;
+        resampleTrace(Trace.vals, Trace.frequency, Resamplers);
+        AddNewTrace(Trace);
+        state.tracesInFile ++;
+        state.v_bat = -1.0; state.temp_1 = -1.0; state.temp_2 = -1.0; state.temp_3 = -1.0;
+    }
+}
+
+static void parseLine(const QString &line, t_FileState &state, QString fileName)
+{
+    QStringList s3 = line.split(QChar(','));
+
+    if (s3.length() == 3 && s3[2]!= "")
+    {
+        // Seems to be a data line. Add it on.
+        std::array<float, 3> m;
+        bool ok = true;
+        if (!!ok)
+        {
+            m[0] = s3[0].toFloat(&ok);
+        }
+        if (!!ok)
+        {
+            m[1] = s3[1].toFloat(&ok);
+        }
+        if (!!ok)
+        {
+            m[2] = s3[2].toFloat(&ok);
+        }
+        if (!!ok)
+        {
+            state.xyz.push_back(m);
+        }
+    }
+    else
+    {
+        // Not a data line.
+        flushBlock(state, fileName);
+
+        int pos;
+        pos = line.indexOf("Vbat=");
+        if (pos >= 0)
+        {
+            QStringRef subString(&line, pos+5, line.length()-pos-5);
+            state.v_bat = subString.split(" ")[0].toFloat();
+        }
+        pos = line.indexOf("Tint=");
+        if (pos >= 0)
+        {
+            QStringRef subString(&line, pos+5, line.length()-pos-5);
+            state.temp_1 = subString.split(" ")[0].toFloat();
+        }
+        pos = line.indexOf("Tacc=");
+        if (pos >= 0)
+        {
+            QStringRef subString(&line, pos+5, line.length()-pos-5);
+            state.temp_2 = subString.split(" ")[0].toFloat();
+        }
+        pos = line.indexOf("Text=");
+        if (pos >= 0)
+        {
+            QStringRef subString(&line, pos+5, line.length()-pos-5);
+            state.temp_3 = subString.split(" ")[0].toFloat();
+        }
+        pos = line.indexOf(" F=");
+        if (pos >= 0)
+        {
+            QStringRef subString(&line, pos+3, line.length()-pos-3);
+            float f = subString.split(" ")[0].toFloat();
+            if (f > 0.0f)
+            {
+                state.frequency = f;
+            }
+        }
+        pos = line.indexOf(" C=");
+        if (pos >= 0)
+        {
+            QStringRef subString(&line, pos+3, line.length()-pos-3);
+            bool ok;
+            int c = subString.split(" ")[0].toInt(&ok);
+            state.headerCount = ok ? c : -1;
+        }
+
+        if (line.length() > 2 && line[2] == '/')
+        {
+            // Looks like a datetime line
+            state.dt = QDateTime::fromString(line, "dd/MM/yyyy,HH:mm:ss,");
+            state.dt.setTimeSpec(Qt::UTC);
+        }
+        else if (line.startsWith("HEARTBEAT") || line.startsWith("ON"))
+        {
+            t_Extra extra;
+            extra.dt = state.dt;
+            extra.type = line.startsWith("ON") ? t_ExtraType::On : t_ExtraType::Heartbeat;
+            extra.v_bat = state.v_bat;
+            extra.temp_1 = state.temp_1;
+            extra.temp_2 = state.temp_2;
+            extra.temp_3 = state.temp_3;
+            extra.fileName = fileName;
+            state.v_bat = -1.0; state.temp_1 = -1.0; state.temp_2 = -1.0; state.temp_3 = -1.0;
+            checkHeartbeat(state, extra, getQualityLimits());
+            if (Sink != nullptr)
+            {
+                Sink->extra(extra);
+            }
+            else
+            {
+                Telemetry.append(extra);
+            }
+        }
+        else
+        {
+
+        }
+    }
+}
+
+// Parse the complete lines of "bytes", adding the length parsed to the state's
+// offset and returning it. The last line is parsed even without its newline if
+// "final" is set.
+static int parseLines(const char *bytes, int size, t_FileState &state, const QString &fileName, bool final)
+{
+    int start = 0;
+    while (start < size)
+    {
+        const char *nl = static_cast<const char *>(memchr(bytes + start, '\n', static_cast<size_t>(size - start)));
+        if (nl == nullptr && !final)
+        {
+            break;  // incomplete line -- wait for the rest of it
+        }
+        int end = (nl == nullptr) ? size : static_cast<int>(nl - bytes);
+        int next = (nl == nullptr) ? size : end + 1;
+        int len = end - start;
+        if (len > 0 && bytes[start + len - 1] == '\r')
+        {
+            len --;
+        }
+        parseLine(QString::fromLatin1(bytes + start, len), state, fileName);
+        start = next;
+    }
+    state.offset += start;
+    return start;
+}
+
+// When following a file (loadtraceAppend()), a block of samples at its end may
+// still be being written. It's only made into a trace once it's as long as the
+// longest block before it in the file, or once the file hasn't grown for a few
+// blocks' time. ("C=" isn't the number of samples, so can't say when a block is
+// complete.) A one-shot load takes each file as it is.
+static const int IdleBlocks = 3;
+static const int DefaultBlockSamples = 500;     // until a block has been seen
+
+static bool fileIdle(const t_FileState &state, const QDateTime &now)
+{
+    const int samples = (state.blockSamples > 0) ? state.blockSamples : DefaultBlockSamples;
+    const qint64 blockMs = qRound64(1000.*samples/static_cast<qreal>(qMax(state.frequency, 1.0f)));
+    return !state.lastGrowth.isValid() || state.lastGrowth.msecsTo(now) >= IdleBlocks*blockMs;
+}
+
+static bool trailingBlockDone(const t_FileState &state, const QDateTime &now)
+{
+    return (state.blockSamples > 0 && static_cast<int>(state.xyz.size()) >= state.blockSamples) || fileIdle(state, now);
+}
+
+// Parse the complete lines of a file beyond the point the last read stopped,
+// and the trailing block if it's done. A last line without its newline is only
+// parsed once the file is idle.
+static void parseFile(QFileInfo fInfo, t_FileState &state, const QDateTime &now)
+{
+    QFile file(fInfo.filePath());
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(state.offset))
+    {
+        return;
+    }
+    QByteArray bytes = file.readAll();
+    file.close();
+
+    parseLines(bytes.constData(), bytes.size(), state, fInfo.fileName(), fileIdle(state, now));
+
+    if (trailingBlockDone(state, now))
+    {
+        flushBlock(state, fInfo.fileName());
+    }
+}
+
+// Parse a whole file from the buffers of the read-ahead, including its last line
+// and block, however recently it was written.
+static void parseBuffers(t_ReadAhead &reader, QFileInfo fInfo, t_FileState &state)
+{
+    const QString fileName = fInfo.fileName();
+    QByteArray carry;   // the start of a line split between buffers
+    bool last = false;
+    while (!last)
+    {
+        t_ReadBuffer *buffer = reader.next();
+        const char *bytes = buffer->data.data();
+        const int size = buffer->size;
+        int used = 0;
+        last = buffer->last;
+
+        if (!carry.isEmpty())
+        {
+            const char *nl = static_cast<const char *>(memchr(bytes, '\n', static_cast<size_t>(size)));
+            used = (nl == nullptr) ? size : static_cast<int>(nl - bytes) + 1;
+            carry.append(bytes, used);
+            if (nl != nullptr || last)
+            {
+                parseLines(carry.constData(), carry.size(), state, fileName, last);
+                carry.clear();
+            }
+        }
+        used += parseLines(bytes + used, size - used, state, fileName, last);
+        carry.append(bytes + used, size - used);
+
+        reader.release(buffer);
+    }
+    state.lastSize = state.offset;
+    flushBlock(state, fileName);
 }
 
 t_Traces * loadtrace(QDir fDir, QList<QFileInfo> fFiles)
@@ -349,157 +842,108 @@ t_Traces * loadtrace(QDir fDir, QList<QFileInfo> fFiles)
     QDateTime dt = QDateTime::currentDateTime();
 
     Traces.clear();
+    invalidateSummaries();
+    invalidateTimeline();
+    Telemetry.clear();
+    getExceedanceScanner().clear();
+    getExceedanceScanner().setLevels(loadExceedanceLevels(fDir));
+    getQualityLimits() = loadQualityLimits(fDir);
+    FileStates.clear();
+    Resamplers.clear();
+    EventOfTrace.clear();
+    VdvOfTrace.clear();
+    Vdvs.clear();
+    SunkTraces = 0;
 
     if (fFiles.isEmpty())
     {
         fFiles = fDir.entryInfoList(QDir::Files);
     }
 
+    QList<QFileInfo> csvFiles;
     foreach (QFileInfo fInfo, fFiles)
     {
         if (fInfo.suffix().toLower() == "csv")
         {
-            int traces_in_file = 0;
-            QFile file(fInfo.filePath());
-            if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                std::vector<std::array<float, 3>> xyz;
-
-                float v_bat, temp_1, temp_2, temp_3;
-
-                v_bat = -1.0; temp_1 = -1.0; temp_2 = -1.0; temp_3 = -1.0;
-                xyz.clear();
-
-                QTextStream in(&file);
-                while (!in.atEnd()) {
-                    QString line = in.readLine();
-
-                    QStringList s3 = line.split(QChar(','));
-
-                    if (s3.length() == 3 && s3[2]!= "")
-                    {
-                        // Seems to be a data line. Add it on.
-                        std::array<float, 3> m;
-                        bool ok = true;
-                        if (!!ok)
-                        {
-                            m[0] = s3[0].toFloat(&ok);
-                        }
-                        if (!!ok)
-                        {
-                            m[1] = s3[1].toFloat(&ok);
-                        }
-                        if (!!ok)
-                        {
-                            m[2] = s3[2].toFloat(&ok);
-                        }
-                        if (!!ok)
-                        {
-                            xyz.push_back(m);
-                        }
-                    }
-                    else
-                    {
-                        // Not a data line.
-                        if (xyz.size() > 0)
-                        {
-                            t_Trace Trace;
-                            Trace.isOn = false;
-                            Trace.isHeartbeat = false;
-                            Trace.dt = dt;
-                            Trace.vals = xyz;
-                            Trace.indexInFile = traces_in_file;
-                            Trace.fileName = fInfo.fileName();
-                            xyz.clear();
-                            AddNewTrace(Trace);
-                            traces_in_file ++;
-                            v_bat = -1.0; temp_1 = -1.0; temp_2 = -1.0; temp_3 = -1.0;
-                        }
-
-                        int pos;
-                        pos = line.indexOf("Vbat=");
-                        if (pos >= 0)
-                        {
-                            QStringRef subString(&line, pos+5, line.length()-pos-5);
-                            v_bat = subString.split(" ")[0].toFloat();
-                        }
-                        pos = line.indexOf("Tint=");
-                        if (pos >= 0)
-                        {
-                            QStringRef subString(&line, pos+5, line.length()-pos-5);
-                            temp_1 = subString.split(" ")[0].toFloat();
-                        }
-                        pos = line.indexOf("Tacc=");
-                        if (pos >= 0)
-                        {
-                            QStringRef subString(&line, pos+5, line.length()-pos-5);
-                            temp_2 = subString.split(" ")[0].toFloat();
-                        }
-                        pos = line.indexOf("Text=");
-                        if (pos >= 0)
-                        {
-                            QStringRef subString(&line, pos+5, line.length()-pos-5);
-                            temp_3 = subString.split(" ")[0].toFloat();
-                        }
-
-                        if (line[2] == '/')
-                        {
-                            // Looks like a datetime line
-                            dt = QDateTime::fromString(line, "dd/MM/yyyy,HH:mm:ss,");
-                            dt.setTimeSpec(Qt::UTC);
-                        }
-                        else if (line.startsWith("HEARTBEAT"))
-                        {
-                           t_Extra extra;
-                           extra.dt = dt;
-                           extra.type = t_ExtraType::Heartbeat;
-                           extra.v_bat = v_bat;
-                           extra.temp_1 = temp_1;
-                           extra.temp_2 = temp_2;
-                           extra.temp_3 = temp_3;
-                           extra.fileName = fInfo.fileName();
-                           v_bat = -1.0; temp_1 = -1.0; temp_2 = -1.0; temp_3 = -1.0;
-                           Extras.push_back(extra);
-
-                        }
-                        else if (line.startsWith("ON"))
-                        {
-                            t_Extra extra;
-                            extra.dt = dt;
-                            extra.type = t_ExtraType::On;
-                            extra.v_bat = v_bat;
-                            extra.temp_1 = temp_1;
-                            extra.temp_2 = temp_2;
-                            extra.temp_3 = temp_3;
-                            extra.fileName = fInfo.fileName();
-                            v_bat = -1.0; temp_1 = -1.0; temp_2 = -1.0; temp_3 = -1.0;
-                            Extras.push_back(extra);
-                        }
-                        else
-                        {
-
-                        }
-                    }
-                }
-
-                if (xyz.size() > 0)
-                {
-                    t_Trace Trace;
-                    Trace.isOn = false;
-                    Trace.isHeartbeat = false;
-                    Trace.vals = xyz;
-                    Trace.dt = dt;
-                    Trace.indexInFile = traces_in_file;
-                    Trace.fileName = fInfo.fileName();
-                    xyz.clear();
-                    AddNewTrace(Trace);
-                    traces_in_file ++;
-                    v_bat = -1.0; temp_1 = -1.0; temp_2 = -1.0; temp_3 = -1.0;
-                }
-
-                file.close();
-            }
+            csvFiles.append(fInfo);
         }
     }
+
+    // The files are read ahead on another thread while they're parsed here
+    QElapsedTimer timer;
+    timer.start();
+    t_ReadAhead reader(csvFiles);
+    t_FileState previous;
+    newFileState(previous, dt);
+    foreach (QFileInfo fInfo, csvFiles)
+    {
+        t_FileState state;
+        newFileState(state, dt);
+        carryQuality(state, previous);
+        parseBuffers(reader, fInfo, state);
+        dt = state.dt;
+        previous = state;
+        FileStates.insert(fInfo.absoluteFilePath(), state);
+    }
+
+    const qreal seconds = qMax(timer.elapsed(), static_cast<qint64>(1))/1000.;
+    const qreal megabytes = static_cast<qreal>(reader.bytesRead())/1.e6;
+    qCInfo(lcProfile, "Loaded %d files, %.1f MB in %.2f s: %.1f MB/s (%.2f s waiting to read)",
+          csvFiles.size(), megabytes, seconds, megabytes/seconds, reader.parserWaitMs()/1000.);
     return &Traces;
 
 }
+
+// Parse all the .CSV files of a directory as loadtrace() does, but hand each
+// trace (with its statistics and exclusion) and each extra to "sink" as soon as
+// it is complete, rather than keeping them. Only the VDV sums are kept.
+void loadtraceStreaming(QDir fDir, t_Sink &sink)
+{
+    SinkHasExclusions = createConnection(fDir);
+    Sink = &sink;
+    loadtrace(fDir, QList<QFileInfo>());
+    Sink = nullptr;
+}
+
+bool isLoadedFile(QFileInfo fInfo)
+{
+    return FileStates.contains(fInfo.absoluteFilePath());
+}
+
+// Read whatever has been added to a file since it was last read, which may be
+// a new file. A trailing block of samples is held back until it's done, see
+// trailingBlockDone(). Returns the index of the first new trace.
+int loadtraceAppend(QFileInfo fInfo)
+{
+    int first = Traces.size();
+    QString key = fInfo.absoluteFilePath();
+
+    if (!FileStates.contains(key))
+    {
+        t_FileState state;
+        newFileState(state, QDateTime::currentDateTime());
+        const t_FileState *latest = latestFileState();
+        if (latest != nullptr)
+        {
+            carryQuality(state, *latest);
+        }
+        state.lastGrowth = fInfo.lastModified();
+        FileStates.insert(key, state);
+    }
+    t_FileState &state = FileStates[key];
+
+    fInfo.refresh();
+    qint64 size = fInfo.size();
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    if (state.lastSize >= 0 && size != state.lastSize)
+    {
+        state.lastGrowth = now;
+    }
+    if (size >= state.offset)   // a file that has shrunk has been replaced -- can't be followed
+    {
+        parseFile(fInfo, state, now);
+    }
+    state.lastSize = size;
+
+    return first;
+}
@@ -3,12 +3,15 @@
 
 #include <QDateTime>
 #include <QList>
+#include <QMap>
 #include <QDir>
 #include <QTreeWidgetItem>
 #include <QString>
 #include <array>
 #include <vector>
 
+#include "samples.h"
+
 class t_Trace
 {
 public:
@@ -22,13 +25,59 @@ public:
     int     indexInFile;
     int     indexInDir;
     uint    exclusion;
-    float   frequency;
+    float   frequency;  // Hz
+    int     headerCount;    // "C=" of the block header, -1 if there was none
     float   wMax;   // windowed maximum
 
+    qreal   wPeak;  // windowed peak of this trace alone, < 0 if not yet calculated
+    float   dominantFrequency;  // Hz, of the summed axis spectra
+    float   bandRms[3];         // RMS within each of the bands in spectrum.h
+
     int    maxAxis;  // axis of greatest deviation. 0 = X, 1 = Y, 2 = Z
-    std::vector<std::array<float,3>> vals;
+    uint   quality;  // t_QualityFlag bits, see quality.h
+    std::vector<std::array<float,3>> vals;     // normalised to g, unless the samples are packed
+    t_PackedSamples packed;                    // see samples.h
 };
 
+// Calls f(x, y, z) with each sample of a trace in turn, normalised to g, however
+// the samples are held. Packed samples are converted a short run at a time into
+// a float buffer on the stack, in a loop of its own (which GCC vectorises at
+// -O3, not -O2), so that "f" always runs over floats. The products are still taken
+// in double, so the floats are exactly those read from the file.
+template<class F> inline void forEachSample(const t_Trace &trace, F f)
+{
+    if (!trace.packed.narrow.empty())
+    {
+        const int ScratchSamples = 256;
+        float scratch[3*ScratchSamples];
+        const qint32 ox = trace.packed.offset[0], oy = trace.packed.offset[1], oz = trace.packed.offset[2];
+        const qint16 *s = trace.packed.narrow.data()->data();
+        const int n = static_cast<int>(trace.packed.narrow.size());
+        for (int start = 0; start < n; start += ScratchSamples)
+        {
+            const int count = qMin(ScratchSamples, n - start);
+            const qint16 *p = s + 3*start;
+            for (int k = 0; k < count; k ++)
+            {
+                scratch[3*k]     = static_cast<float>((ox + p[3*k])*SampleScale);
+                scratch[3*k + 1] = static_cast<float>((oy + p[3*k + 1])*SampleScale);
+                scratch[3*k + 2] = static_cast<float>((oz + p[3*k + 2])*SampleScale);
+            }
+            for (int k = 0; k < count; k ++)
+            {
+                f(scratch[3*k], scratch[3*k + 1], scratch[3*k + 2]);
+            }
+        }
+    }
+    else
+    {
+        for (const std::array<float,3> &s : trace.vals)
+        {
+            f(s[0], s[1], s[2]);
+        }
+    }
+}
+
 typedef enum
 {
     Heartbeat = 1,   // hourly heartbeat record
@@ -54,21 +103,73 @@ public:
     QDateTime start;
     QDateTime end;
     float     total_VDV;
+    qreal     sum_4thPower;   // running sum, total_VDV is its 4th root
+    QVector<int> traces;      // indexes of the traces in this period
 };
 
 typedef QVector<t_VDV> t_VDVs;
 
 typedef QVector<t_Trace> t_Traces;
 
-typedef QList<t_Extra> t_Extras;
+// Parser state of one file, kept so that a growing file can be re-read from
+// where the last read stopped.
+class t_FileState
+{
+public:
+    qint64      offset;         // bytes consumed so far (always at a line start)
+    qint64      lastSize;       // file size when last looked at
+    QDateTime   lastGrowth;     // when the file was last seen to grow
+    QDateTime   dt;
+    int         tracesInFile;
+    float       frequency;      // "F=" of the latest block header
+    int         headerCount;    // "C=" of the latest block header
+    float v_bat, temp_1, temp_2, temp_3;
+    std::vector<std::array<float,3>> xyz;   // samples of a block not yet finished
+
+    // For the quality checks
+    int         blockSamples;   // longest block so far
+    int         modalSamples;   // most common block length so far
+    QMap<int, int> blockLengths;    // number of blocks of each length
+    QDateTime   lastTraceDt;
+    QDateTime   lastHeartbeat;
+    bool        vbatBad;
+};
+
+// Receives traces and extras as they are parsed, see loadtraceStreaming()
+class t_Sink
+{
+public:
+    virtual ~t_Sink() {}
+    virtual void trace(t_Trace &trace) = 0;
+    virtual void extra(const t_Extra &extra) = 0;
+};
 
+extern int traceCount(void);
 extern t_Trace * getTrace(int index);
-extern t_Extra * getExtra(int index);
+extern bool getExtra(int index, t_Extra &extra);
 
 extern t_Traces * loadtrace(QDir, QList<QFileInfo>);
-extern void  processExclusions(QDir dir);
+extern int   loadtraceAppend(QFileInfo fInfo);
+extern void  loadtraceStreaming(QDir fDir, t_Sink &sink);
+extern bool  isLoadedFile(QFileInfo fInfo);
+extern void  processExclusions(QDir dir, int first = 0);
 extern t_VDVs postProcessVdv(void);
+extern void   vdvPeriodBounds(QDateTime dt, QDateTime &start, QDateTime &end);
+extern qreal  vdvContribution(const t_Trace &trace);
+extern void   addVdv(int first);
+extern void   addTraceToVdv(const t_Trace &trace);
+extern t_VDVs currentVdv(void);
+extern int    setExclusion(int index, uint exclusion);
+extern void   setExclusions(const QVector<int> &indexes, uint exclusion);
 
+extern QVector<qreal> ValsToRms(const t_Trace &trace);
+extern size_t sampleCount(const t_Trace &trace);
+extern std::vector<float> axisSamples(const t_Trace &trace, int axis);
 extern void addWindowedMax(void);
+extern int  eventStart(int index);
+extern int  eventEnd(int base);
+extern void updateWindowedMax(int first);
+extern qreal traceWindowedPeak(t_Trace &trace);
+extern float windowedMaxFromPeak(qreal peak);
 
 #endif // LOADTRACE_H
@@ -12,9 +12,31 @@
 #include <QAction>
 #include <QTextStream>
 #include <QtMath>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QCheckBox>
+#include <QDateTimeEdit>
+#include <QMessageBox>
+
+#include <algorithm>
 
 #include "tablewidget.h"
 #include "loadtrace.h"
+#include "results.h"
+#include "summaries.h"
+#include "batch.h"
+#include "spectrum.h"
+#include "resample.h"
+#include "samples.h"
+#include "report.h"
+#include "warehouse.h"
+#include "quality.h"
+#include "rules.h"
+#include "window.h"
 
 #include <QSqlQuery>
 #include <QSqlQueryModel>
@@ -37,6 +59,18 @@ MyModel::MyModel(QWidget *parent)
     d1->setAcceptMode(QFileDialog::AcceptOpen);
     openDialog = d1;
 
+    isLive = false;
+    watcher = new QFileSystemWatcher(this);
+    connect(watcher, &QFileSystemWatcher::directoryChanged, this, &MyModel::refreshLive);
+    connect(watcher, &QFileSystemWatcher::fileChanged, this, &MyModel::refreshLive);
+
+    // Not all file systems (e.g. network shares) report changes, so poll as well.
+    liveTimer = new QTimer(this);
+    liveTimer->setInterval(2000);
+    connect(liveTimer, &QTimer::timeout, this, &MyModel::refreshLive);
+
+    // Everything opened is added to the long-term results. Without it, that's all.
+    openWarehouse(defaultWarehousePath());
 }
 
 void MyModel::set_1(void)
@@ -70,7 +104,7 @@ void MyModel::set_x(unsigned int k)
         if (query.first())
         {
             int id_1 = query.value(0).toInt();
-            query.prepare("update trace set exclusion=:k where id=:id");
+            query.prepare("update trace set exclusion=:k, rule=null where id=:id");   // set by hand, not by a rule
             query.bindValue(":k", k);
             query.bindValue(":id", id_1);
             query.exec();
@@ -85,9 +119,13 @@ void MyModel::set_x(unsigned int k)
             query.exec();
         }
 
-        // Now set up a non-const reference to write to.
-        t_Trace &newT = (*theTraces)[m];
-        newT.exclusion = k;
+        // Update the trace, and whatever has been calculated from it.
+        int base = setExclusion(m, k);
+        if (base >= 0 && base < treeWidget->topLevelItemCount())
+        {
+            setLeaf(treeWidget->topLevelItem(base), base);
+        }
+        storeInWarehouse(currentDirectory, eventStart(m), eventEnd(eventStart(m)));
     }
 
     QTreeWidgetItem *leaf = treeWidget->currentItem();
@@ -107,49 +145,73 @@ void MyModel::set_x(unsigned int k)
 
 }
 
-void MyModel::setTree(QTreeWidget * treeWidgetTopLevel)
+void MyModel::setLeaf(QTreeWidgetItem *leaf, int i)
 {
-    treeWidgetTopLevel->clear();
-
-    for(int end = theTraces->size(), i = 0; i < end; i ++)
+    leaf->setText(0, theTraces->at(i).fileName);
+    leaf->setText(1, theTraces->at(i).dt.toString("dd-HH:mm:ss") );
+    leaf->setText(2, QString::number(static_cast<qreal>(theTraces->at(i).maximumDeviation)));
+    leaf->setText(3, QString::number(static_cast<qreal>(theTraces->at(i).rmsDeviation)));
+    if (saveWithWindowedMax)
     {
-        QTreeWidgetItem *leaf = new QTreeWidgetItem();
-        leaf->setText(0, theTraces->at(i).fileName);
-        leaf->setText(1, theTraces->at(i).dt.toString("dd-HH:mm:ss") );
-        leaf->setText(2, QString::number(static_cast<qreal>(theTraces->at(i).maximumDeviation)));
-        leaf->setText(3, QString::number(static_cast<qreal>(theTraces->at(i).rmsDeviation)));
-        if (saveWithWindowedMax)
+        qreal x = static_cast<qreal>(theTraces->at(i).wMax);
+        if (x > 0.)
         {
-            qreal x = static_cast<qreal>(theTraces->at(i).wMax);
-            if (x > 0.)
-            {
-                //leaf->setText(4, QString::number(20.*qLn(x/16384./1.E-6)/qLn(10.), 'f', 1));  // units of dB ug (Sometimes required)
-                leaf->setText(4, QString::number(x, 'f', 3));  // same units as max/rms above
-            }
-            else
-            {
-                leaf->setText(4, "");
-            }
+            //leaf->setText(4, QString::number(20.*qLn(x/16384./1.E-6)/qLn(10.), 'f', 1));  // units of dB ug (Sometimes required)
+            leaf->setText(4, QString::number(x, 'f', 3));  // same units as max/rms above
         }
-        if (theTraces->at(i).exclusion > 0)
+        else
         {
-            for(int j = 0; j < leaf->columnCount(); j ++)
-            {
-                leaf->setBackground(j, excBrush);
-            }
+            leaf->setText(4, "");
         }
-        else
+    }
+    leaf->setText(saveWithWindowedMax ? 5 : 4, QString::number(static_cast<qreal>(theTraces->at(i).dominantFrequency), 'f', 1));
+    leaf->setText(saveWithWindowedMax ? 6 : 5, qualityText(theTraces->at(i).quality));
+    if (theTraces->at(i).exclusion > 0)
+    {
+        for(int j = 0; j < leaf->columnCount(); j ++)
         {
-            for(int j = 0; j < leaf->columnCount(); j ++)
-            {
-                leaf->setBackground(j, nonexcBrush);
-            }
+            leaf->setBackground(j, excBrush);
+        }
+    }
+    else
+    {
+        for(int j = 0; j < leaf->columnCount(); j ++)
+        {
+            leaf->setBackground(j, nonexcBrush);
         }
-        leaf->setData(0, Qt::UserRole+1, QVariant(static_cast<uint>(i)));
+    }
+    leaf->setData(0, Qt::UserRole+1, QVariant(static_cast<uint>(i)));
+}
+
+void MyModel::setTree(QTreeWidget * treeWidgetTopLevel)
+{
+    treeWidgetTopLevel->clear();
+
+    for(int end = theTraces->size(), i = 0; i < end; i ++)
+    {
+        QTreeWidgetItem *leaf = new QTreeWidgetItem();
+        setLeaf(leaf, i);
         treeWidgetTopLevel->addTopLevelItem(leaf);
     }
 }
 
+// Add rows for traces appended from index "first". Rows of the event that the
+// new traces may have joined are refreshed too, as its windowed max can change.
+void MyModel::appendTree(int first)
+{
+    for(int i = eventStart(first); i < first && i < treeWidget->topLevelItemCount(); i ++)
+    {
+        setLeaf(treeWidget->topLevelItem(i), i);
+    }
+
+    for(int end = theTraces->size(), i = first; i < end; i ++)
+    {
+        QTreeWidgetItem *leaf = new QTreeWidgetItem();
+        setLeaf(leaf, i);
+        treeWidget->addTopLevelItem(leaf);
+    }
+}
+
 void MyModel::open(void)
 {
     openDialog->setDefaultSuffix("CSV");
@@ -181,8 +243,85 @@ void MyModel::open(void)
         {
             addWindowedMax();
         }
+        postProcessVdv();
+        addSpectra(0);
+        storeInWarehouse(currentDirectory, 0);
 
         setTree(treeWidget);
+
+        // Start following the newly opened directory
+        setLive(isLive);
+    }
+}
+
+void MyModel::setLive(bool live)
+{
+    isLive = live;
+
+    if (!watcher->files().isEmpty())
+    {
+        watcher->removePaths(watcher->files());
+    }
+    if (!watcher->directories().isEmpty())
+    {
+        watcher->removePaths(watcher->directories());
+    }
+    liveTimer->stop();
+    ignoredFiles.clear();
+
+    if (!isLive || !haveCurrentDirectory)
+        return;
+
+    // Only files that were opened, or that appear from now on, are followed.
+    QList<QFileInfo> files = currentDirectory.entryInfoList(QStringList() << "*.csv", QDir::Files);
+    foreach (QFileInfo fInfo, files)
+    {
+        if (isLoadedFile(fInfo))
+        {
+            watcher->addPath(fInfo.filePath());
+        }
+        else
+        {
+            ignoredFiles.insert(fInfo.fileName());
+        }
+    }
+    watcher->addPath(currentDirectory.path());
+    liveTimer->start();
+}
+
+void MyModel::refreshLive(void)
+{
+    if (!isLive || !haveCurrentDirectory)
+        return;
+
+    int first = theTraces->size();
+
+    QList<QFileInfo> files = currentDirectory.entryInfoList(QStringList() << "*.csv", QDir::Files, QDir::Name | QDir::IgnoreCase);
+    foreach (QFileInfo fInfo, files)
+    {
+        if (ignoredFiles.contains(fInfo.fileName()))
+            continue;
+
+        if (!watcher->files().contains(fInfo.filePath()))
+        {
+            watcher->addPath(fInfo.filePath());
+        }
+        loadtraceAppend(fInfo);
+    }
+
+    if (theTraces->size() > first)
+    {
+        // Only the new traces, and the event they are part of, need processing.
+        processExclusions(currentDirectory, first);
+        if (saveWithWindowedMax)
+        {
+            updateWindowedMax(first);
+        }
+        addVdv(first);
+        addSpectra(first);
+        storeInWarehouse(currentDirectory, eventStart(first));
+
+        appendTree(first);
     }
 }
 
@@ -208,98 +347,183 @@ void MyModel::save(void)
         if(file.open(QFile::WriteOnly))
         {
             QTextStream out(&file);
-            out << "File name,Date/time,Max., RMS,";
-            if (saveWithWindowedMax)
-            {
-                out << "Windowed Max.,";
-            }
-            out << "Excluded?" << "\n";
+            writeResults(out, saveWithWindowedMax);
+        }
+    }
+}
 
-            int i = 0;
-            while (true)
-            {
-                t_Trace * p_t = getTrace(i);
-                if (p_t == nullptr)
-                {
-                    break;
-                }
-                else
-                {
-                    out << p_t->fileName
-                        << "," << p_t->dt.toString("dd/MM/yyyy HH:mm:ss")
-                        << "," << QString::number(static_cast<qreal>(p_t->maximumDeviation))
-                        << "," << QString::number(static_cast<qreal>(p_t->rmsDeviation));
-                    if (saveWithWindowedMax)
-                    {
-                        out << "," << QString::number(static_cast<qreal>(p_t->wMax));
-                    }
-                    out << ",";
-                    if (p_t->exclusion > 0)
-                    {
-                        out << "X";
-                    }
-                    // else nothing...
-                    out << "\n";
-                }
-                i ++;
-            }
+void MyModel::query(void)
+{
+    if (!haveCurrentDirectory || theTraces->isEmpty())
+        return;
 
+    QDialog dialog(treeWidget);
+    dialog.setWindowTitle(QDialog::tr("Select largest"));
+    QFormLayout *form = new QFormLayout(&dialog);
 
-            // Now calculate VDV values
-            t_VDVs vs = postProcessVdv();
-            out << "Start,End,VDV [m s^-1.75]" << "\n";
-            for(int endj = vs.size(), j = 0; j < endj; j ++)
-            {
-                out << vs[j].start.toString("dd/MM/yyyy HH:mm:ss")
-                    << "," << vs[j].end.toString("dd/MM/yyyy HH:mm:ss")
-                    << "," << QString::number(static_cast<qreal>(vs[j].total_VDV)) << "\n";
-            }
+    QComboBox *column = new QComboBox(&dialog);
+    for (int c = 0; c < NumSummaryColumns; c ++)
+    {
+        column->addItem(SummaryColumnNames[c]);
+    }
+    column->setCurrentIndex(saveWithWindowedMax ? ColWMax : ColMax);
+    form->addRow(QDialog::tr("Column"), column);
+
+    QComboBox *mode = new QComboBox(&dialog);
+    mode->addItem(QDialog::tr("Largest number"));
+    mode->addItem(QDialog::tr("Largest percentage"));
+    mode->addItem(QDialog::tr("Largest percentage per day/night"));
+    form->addRow(QDialog::tr("Select"), mode);
+
+    QSpinBox *k = new QSpinBox(&dialog);
+    k->setRange(1, theTraces->size());
+    k->setValue(qMin(50, theTraces->size()));
+    form->addRow(QDialog::tr("Number"), k);
+
+    QDoubleSpinBox *percent = new QDoubleSpinBox(&dialog);
+    percent->setRange(0.01, 100.);
+    percent->setValue(1.);
+    form->addRow(QDialog::tr("Percentage"), percent);
+
+    QDateTimeEdit *from = new QDateTimeEdit(theTraces->first().dt, &dialog);
+    from->setTimeSpec(Qt::UTC);
+    form->addRow(QDialog::tr("From"), from);
+    QDateTimeEdit *to = new QDateTimeEdit(theTraces->last().dt, &dialog);
+    to->setTimeSpec(Qt::UTC);
+    form->addRow(QDialog::tr("To"), to);
+
+    QCheckBox *includeExcluded = new QCheckBox(&dialog);
+    form->addRow(QDialog::tr("Include excluded"), includeExcluded);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+
+    t_TraceFilter filter;
+    filter.from = from->dateTime();
+    filter.to = to->dateTime();
+    filter.includeExcluded = includeExcluded->isChecked();
+    t_SummaryColumn col = static_cast<t_SummaryColumn>(column->currentIndex());
+
+    t_RankedList ranked;
+    if (mode->currentIndex() == 0)
+    {
+        ranked = topK(col, k->value(), filter);
+    }
+    else if (mode->currentIndex() == 1)
+    {
+        ranked = topPercent(col, percent->value(), filter);
+    }
+    else
+    {
+        ranked = topPercentPerPeriod(col, percent->value(), filter, currentVdv());
+    }
+
+    // Show the result as the selection in the tree
+    treeWidget->clearSelection();
+    foreach (const t_Ranked &r, ranked)
+    {
+        QTreeWidgetItem *leaf = treeWidget->topLevelItem(r.trace);
+        if (leaf != nullptr)
+        {
+            leaf->setSelected(true);
+        }
+    }
+    if (!ranked.isEmpty())
+    {
+        treeWidget->scrollToItem(treeWidget->topLevelItem(ranked.first().trace));
+    }
+}
 
-            // Now output heartbeat information
-            out << "File name,Date/time,Type,V_bat [V],Temp 1 [degC],Temp2 [degC],Temp3 [degC]" << "\n";
-            i = 0;
-            while (true)
+void MyModel::applyRules(void)
+{
+    if (!haveCurrentDirectory || theTraces->isEmpty())
+        return;
+
+    QString path = QFileDialog::getOpenFileName(treeWidget, QFileDialog::tr("Exclusion rules"), currentDirectory.path(),
+                                                QFileDialog::tr("Rules files (*.rules *.txt);;Any files (*)"));
+    if (path.isEmpty())
+        return;
+
+    t_ExclusionRules rules;
+    QString error;
+    if (!loadExclusionRules(path, rules, error))
+    {
+        QMessageBox::warning(treeWidget, QMessageBox::tr("Exclusion rules"), error);
+        return;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    int n = applyExclusionRules(currentDirectory, rules);
+    setTree(treeWidget);
+    storeInWarehouse(currentDirectory, 0);
+    QApplication::restoreOverrideCursor();
+
+    QMessageBox::information(treeWidget, QMessageBox::tr("Exclusion rules"),
+                             QMessageBox::tr("%1 traces excluded.").arg(qMax(n, 0)));
+}
+
+// Change the window of the windowed max, and show and store the new values
+void MyModel::setWindowShape(int shape)
+{
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    setWindow(static_cast<t_WindowShape>(shape), windowSeconds());
+    if (haveCurrentDirectory && !theTraces->isEmpty())
+    {
+        setTree(treeWidget);
+        storeInWarehouse(currentDirectory, 0);
+    }
+    QApplication::restoreOverrideCursor();
+}
+
+void MyModel::report(void)
+{
+    if (!haveCurrentDirectory || theTraces->isEmpty())
+        return;
+
+    // The events of the selected rows (e.g. from a query), or if there's no
+    // more than one row selected, every event that isn't excluded.
+    QVector<int> events;
+    QList<QTreeWidgetItem *> selected = treeWidget->selectedItems();
+    if (selected.size() > 1)
+    {
+        foreach (QTreeWidgetItem *leaf, selected)
+        {
+            int base = eventStart(leaf->data(0, Qt::UserRole+1).toInt());
+            if (!events.contains(base))
             {
-                t_Extra * p_x = getExtra(i);
-                if (p_x == nullptr)
-                {
-                    break;
-                }
-                else
-                {
-                    out << p_x->fileName
-                        << "," << p_x->dt.toString("dd/MM/yyyy HH:mm:ss");
-                    if (p_x->type == t_ExtraType::Heartbeat)
-                    {
-                        out << ",HEARTBEAT";
-                    }
-                    else if (p_x->type == t_ExtraType::On)
-                    {
-                        out << ",ON";
-                    }
-                    else
-                    {
-                        out << ",";
-                    }
-
-                    out << "," << QString::number(static_cast<qreal>(p_x->v_bat))
-                        << "," << QString::number(static_cast<qreal>(p_x->temp_1))
-                        << "," << QString::number(static_cast<qreal>(p_x->temp_2))
-                        << ",";
-                    if (p_x->temp_3 != -1.0)  // comparison with float -- not good!
-                    {
-                        out << "," << QString::number(static_cast<qreal>(p_x->temp_3));
-                    }
-                    out << "\n";
-                }
-                i ++;
+                events.push_back(base);
             }
         }
+        std::sort(events.begin(), events.end());
+    }
+    else
+    {
+        events = significantEvents(0.0f);
+    }
+
+    QString path = QFileDialog::getSaveFileName(treeWidget, QFileDialog::tr("Report"),
+                                                currentDirectory.filePath(currentDirectory.dirName() + "_report.pdf"),
+                                                QFileDialog::tr("PDF files (*.pdf);;PNG files, in a directory (*)"));
+    if (!path.isEmpty())
+    {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        writeReport(path, events);
+        QApplication::restoreOverrideCursor();
     }
 }
 
 int main(int argc, char *argv[])
 {
+    if (isBatchRun(argc, argv))
+    {
+        return runBatch(argc, argv);
+    }
+
     QApplication a(argc, argv);
 
     QWidget *window = new QWidget;
@@ -313,6 +537,38 @@ int main(int argc, char *argv[])
     QPushButton *b2 = new QPushButton(QPushButton::tr("&Save"));
     b1->resize(50, 250);
     buttonsLayout->addWidget(b2);
+    QPushButton *b3 = new QPushButton(QPushButton::tr("&Live"));
+    b3->setCheckable(true);
+    b3->setToolTip(QPushButton::tr("Follow new and growing files in the opened directory"));
+    buttonsLayout->addWidget(b3);
+    QPushButton *b4 = new QPushButton(QPushButton::tr("&Telemetry"));
+    buttonsLayout->addWidget(b4);
+    QPushButton *b8 = new QPushButton(QPushButton::tr("T&imeline"));
+    b8->setToolTip(QPushButton::tr("Every trace on one zoomable time axis"));
+    buttonsLayout->addWidget(b8);
+    QPushButton *b5 = new QPushButton(QPushButton::tr("&Query"));
+    b5->setToolTip(QPushButton::tr("Select the traces with the largest values"));
+    buttonsLayout->addWidget(b5);
+    QPushButton *b6 = new QPushButton(QPushButton::tr("&Report"));
+    b6->setToolTip(QPushButton::tr("Plot the selected events, or all events, to PDF or PNG"));
+    buttonsLayout->addWidget(b6);
+    QPushButton *b7 = new QPushButton(QPushButton::tr("R&ules"));
+    b7->setToolTip(QPushButton::tr("Exclude every trace matched by the rules in a file"));
+    buttonsLayout->addWidget(b7);
+    QCheckBox *resample = new QCheckBox(QCheckBox::tr("125 Hz"));
+    resample->setToolTip(QCheckBox::tr("Resample files recorded at other rates to 125 Hz when opening"));
+    buttonsLayout->addWidget(resample);
+    QCheckBox *compact = new QCheckBox(QCheckBox::tr("Compact"));
+    compact->setToolTip(QCheckBox::tr("Hold samples as integers when opening, in about half the memory but slower to process"));
+    buttonsLayout->addWidget(compact);
+    QComboBox *windowShapes = new QComboBox;
+    for (int w = 0; w < NumWindowShapes; w ++)
+    {
+        windowShapes->addItem(WindowShapeNames[w]);
+    }
+    windowShapes->setCurrentIndex(windowShape());
+    windowShapes->setToolTip(QComboBox::tr("Window for the windowed max"));
+    buttonsLayout->addWidget(windowShapes);
 
     listLayout->addLayout(buttonsLayout);
 
@@ -327,10 +583,20 @@ int main(int argc, char *argv[])
     {
         headers << QTreeWidget::tr("Wind. Max.");
     }
+    headers << QTreeWidget::tr("Dom. freq.") << QTreeWidget::tr("Quality");
     treeWidget->setHeaderLabels(headers);
+    treeWidget->headerItem()->setToolTip(headers.size() - 1, qualityHelp());
+    treeWidget->setSelectionMode(QAbstractItemView::ExtendedSelection);
 
     a.connect(b1, &QPushButton::clicked, model, &MyModel::open);
     a.connect(b2, &QPushButton::clicked, model, &MyModel::save);
+    a.connect(b3, &QPushButton::toggled, model, &MyModel::setLive);
+    a.connect(b5, &QPushButton::clicked, model, &MyModel::query);
+    a.connect(b6, &QPushButton::clicked, model, &MyModel::report);
+    a.connect(b7, &QPushButton::clicked, model, &MyModel::applyRules);
+    a.connect(resample, &QCheckBox::toggled, [](bool on) { setResampleFrequency(on ? 125.0f : 0.0f); });
+    a.connect(compact, &QCheckBox::toggled, [](bool on) { setCompactSamples(on); });
+    a.connect(windowShapes, QOverload<int>::of(&QComboBox::currentIndexChanged), model, &MyModel::setWindowShape);
 
     model->treeWidget = treeWidget;
 
@@ -346,6 +612,12 @@ int main(int argc, char *argv[])
     treeWidget->addAction(action_0);
     a.connect(action_0, &QAction::triggered, model, &MyModel::set_0);
 
+    QAction *action_f = new QAction(QApplication::tr("&Frequency"), treeWidget);
+    action_f->setShortcut(QKeySequence(Qt::Key_F));
+    action_f->setStatusTip(QApplication::tr("Switch between the trace and its spectrum"));
+    action_f->setCheckable(true);
+    treeWidget->addAction(action_f);
+
     treeWidget->setMinimumWidth(450);
     listLayout->addWidget(treeWidget);
 
@@ -364,6 +636,34 @@ int main(int argc, char *argv[])
     window->setLayout(mainLayout);
 
     a.connect(treeWidget, &QTreeWidget::currentItemChanged, &w, &TableWidget::ShowTrace);
+    a.connect(action_f, &QAction::toggled, &w, &TableWidget::setSpectrumMode);
+
+    // Battery and temperature trends, in a window of their own
+    TelemetryWidget telemetry;
+    telemetry.setRenderHint(QPainter::Antialiasing);
+    telemetry.setMinimumSize(800, 400);
+    telemetry.setWindowTitle(QApplication::tr("Telemetry"));
+    telemetry.setChart(new QChart);
+    a.connect(b4, &QPushButton::clicked, &telemetry, &TelemetryWidget::ShowTelemetry);
+
+    // The whole campaign, going to the trace that is double clicked
+    TimelineWidget timeline;
+    timeline.setRenderHint(QPainter::Antialiasing);
+    timeline.setMinimumSize(1000, 400);
+    timeline.setWindowTitle(QApplication::tr("Timeline"));
+    QChart *timelineChart = new QChart;
+    timelineChart->setAnimationOptions(QChart::NoAnimation);
+    timeline.setChart(timelineChart);
+    a.connect(b8, &QPushButton::clicked, &timeline, &TimelineWidget::ShowTimeline);
+    a.connect(&timeline, &TimelineWidget::traceActivated, [treeWidget](int index)
+    {
+        QTreeWidgetItem *leaf = treeWidget->topLevelItem(index);
+        if (leaf != nullptr)
+        {
+            treeWidget->setCurrentItem(leaf);
+            treeWidget->scrollToItem(leaf);
+        }
+    });
 
     window->show();
 
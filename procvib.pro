@@ -1,15 +1,52 @@
-QT += charts widgets sql
+QT += charts widgets sql concurrent
+CONFIG += c++14
 requires(qtConfig(tableview))
 
 HEADERS += \
+    batch.h \
+    correlate.h \
+    distributions.h \
+    exceedance.h \
     loadtrace.h \
+    quality.h \
+    readahead.h \
+    report.h \
+    resample.h \
+    results.h \
+    rules.h \
+    samples.h \
+    spectrum.h \
+    stream.h \
+    summaries.h \
     tablewidget.h \
+    telemetry.h \
+    timeline.h \
+    warehouse.h \
+    window.h \
     sql/connection.h
 
 SOURCES += \
+    batch.cpp \
+    correlate.cpp \
+    distributions.cpp \
+    exceedance.cpp \
     loadtrace.cpp \
     main.cpp \
-    tablewidget.cpp
+    quality.cpp \
+    readahead.cpp \
+    report.cpp \
+    resample.cpp \
+    results.cpp \
+    rules.cpp \
+    samples.cpp \
+    spectrum.cpp \
+    stream.cpp \
+    summaries.cpp \
+    tablewidget.cpp \
+    telemetry.cpp \
+    timeline.cpp \
+    warehouse.cpp \
+    window.cpp
 
 target.path = ../procvib
 INSTALLS += target
@@ -0,0 +1,161 @@
+#include <cmath>
+
+#include <QSettings>
+
+#include "quality.h"
+
+static t_QualityLimits Limits;    // set by loadtrace(), from the data directory
+
+t_QualityLimits &getQualityLimits(void)
+{
+    return Limits;
+}
+
+// Limits are read from "Quality.ini" in the data directory, if there is one:
+//    [Quality]
+//    fullScale=33554.4
+//    jump=8192
+//    stuckSamples=25
+//    checkHeaderCount=false
+//    countTolerance=0
+//    heartbeatGap=3900
+//    vbatMin=3.0
+//    vbatMax=5.0
+//    autoExclude=CS
+// autoExclude is made of the letters of qualityText(). By default nothing is
+// excluded automatically. "C=" doesn't give the number of samples in the
+// recorder's files so far, so it isn't checked unless asked for. Instead a block
+// is taken to be short when it has more than countTolerance samples fewer than
+// the most common length of the blocks before it in the file.
+t_QualityLimits loadQualityLimits(QDir dir)
+{
+    QSettings settings(dir.filePath("Quality.ini"), QSettings::IniFormat);
+    t_QualityLimits l;
+    l.fullScale = settings.value("Quality/fullScale", 33554.4).toFloat();     // ADXL355 at +/-2 g: 2^19 LSBs of 0.064
+    l.jump = settings.value("Quality/jump", 8192.0).toFloat();                 // 0.5 g
+    l.stuckSamples = settings.value("Quality/stuckSamples", 25).toInt();
+    l.checkHeaderCount = settings.value("Quality/checkHeaderCount", false).toBool();
+    l.countTolerance = settings.value("Quality/countTolerance", 0).toInt();
+    l.heartbeatGap = settings.value("Quality/heartbeatGap", 3900).toInt();     // hourly, and a bit
+    l.vbatMin = settings.value("Quality/vbatMin", 3.0).toFloat();
+    l.vbatMax = settings.value("Quality/vbatMax", 5.0).toFloat();
+
+    l.autoExclude = 0;
+    QString letters = settings.value("Quality/autoExclude", "").toString();
+    for (int b = 0; b < NumQualityFlags; b ++)
+    {
+        if (letters.contains(qualityText(1u << b)))
+        {
+            l.autoExclude |= (1u << b);
+        }
+    }
+    return l;
+}
+
+// Checks on the samples of one block, before they're scaled or resampled. The
+// loops count rather than stop at the first problem, and have no branches, so
+// that the compiler can vectorise them.
+uint checkSamples(const std::vector<std::array<float,3>> &vals, const t_QualityLimits &limits)
+{
+    const int n = 3*static_cast<int>(vals.size());
+    if (n == 0)
+        return 0;
+    const float * v = vals.data()->data();     // x, y, z, x, y, z, ...
+
+    int clipped = 0;
+    for (int k = 0; k < n; k ++)
+    {
+        clipped += (std::fabs(v[k]) >= limits.fullScale);
+    }
+
+    int jumps = 0;
+    for (int k = 3; k < n; k ++)
+    {
+        jumps += (std::fabs(v[k] - v[k - 3]) > limits.jump);
+    }
+
+    int run[3] = {0, 0, 0};
+    int longest = 0;
+    for (int k = 3; k < n; k += 3)
+    {
+        for (int a = 0; a < 3; a ++)
+        {
+            run[a] = (v[k + a] == v[k + a - 3]) ? run[a] + 1 : 0;
+            longest = std::max(longest, run[a]);
+        }
+    }
+
+    uint quality = 0;
+    if (clipped > 0)
+        quality |= QualityClipped;
+    if (jumps > 0)
+        quality |= QualityJump;
+    if (longest + 1 >= limits.stuckSamples)
+        quality |= QualityStuck;
+    return quality;
+}
+
+// Checks of a block against the records before it in the same file. "state"
+// holds the block's header and time, and is updated for the next block.
+uint checkBlock(t_FileState &state, int samples, const t_QualityLimits &limits)
+{
+    uint quality = 0;
+
+    if ((state.modalSamples > 0 && samples < state.modalSamples - limits.countTolerance)
+        || (limits.checkHeaderCount && state.headerCount >= 0 && samples != state.headerCount))
+        quality |= QualityCount;
+    if (state.lastTraceDt.isValid() && state.dt == state.lastTraceDt)
+        quality |= QualityRepeatedTime;
+    if (state.lastHeartbeat.isValid() && state.lastHeartbeat.secsTo(state.dt) > limits.heartbeatGap)
+        quality |= QualityHeartbeatGap;
+    if (state.vbatBad)
+        quality |= QualityBattery;
+
+    state.blockSamples = std::max(state.blockSamples, samples);
+    int seen = ++ state.blockLengths[samples];
+    if (state.modalSamples == 0 || seen > state.blockLengths.value(state.modalSamples))
+    {
+        state.modalSamples = samples;
+    }
+    state.lastTraceDt = state.dt;
+    return quality;
+}
+
+void checkHeartbeat(t_FileState &state, const t_Extra &extra, const t_QualityLimits &limits)
+{
+    if (extra.type != t_ExtraType::Heartbeat)
+        return;
+
+    state.lastHeartbeat = extra.dt;
+    if (extra.v_bat != -1.0f)   // not given
+    {
+        state.vbatBad = (extra.v_bat < limits.vbatMin || extra.v_bat > limits.vbatMax);
+    }
+}
+
+// One letter per flag, in the order of t_QualityFlag
+QString qualityText(uint quality)
+{
+    const char letters[NumQualityFlags + 1] = "CSJNTGB";
+    QString s;
+    for (int b = 0; b < NumQualityFlags; b ++)
+    {
+        if (quality & (1u << b))
+        {
+            s += QChar(letters[b]);
+        }
+    }
+    return s;
+}
+
+// What the letters of qualityText() mean, for tool tips
+QString qualityHelp(void)
+{
+    return QString("C: clipped at full scale\n"
+                   "S: an axis stuck at one value\n"
+                   "J: a jump between samples too large to be real\n"
+                   "N: fewer samples than the most common block length in the file (a guess, as \"C=\" isn't the count)\n"
+                   "T: same time as the trace before\n"
+                   "G: too long since the last heartbeat\n"
+                   "B: implausible battery voltage");
+}
@@ -0,0 +1,51 @@
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include <QDir>
+#include <QString>
+#include <array>
+#include <vector>
+
+#include "loadtrace.h"
+
+// Problems found in a trace, or in the records before it. Combined in t_Trace::quality.
+typedef enum
+{
+    QualityClipped      = 0x01,     // samples at the accelerometer's full scale
+    QualityStuck        = 0x02,     // an axis that didn't change for a run of samples
+    QualityJump         = 0x04,     // a step between samples too large to be real
+    QualityCount        = 0x08,     // block shorter than the usual one in the file, or not matching "C="
+    QualityRepeatedTime = 0x10,     // same time as the trace before it
+    QualityHeartbeatGap = 0x20,     // too long since the last heartbeat
+    QualityBattery      = 0x40      // implausible "Vbat=" at the last heartbeat
+
+} t_QualityFlag;
+
+const int NumQualityFlags = 7;
+
+// Exclusion class of traces that are excluded only because of their quality
+const uint QualityExclusion = 2;
+
+class t_QualityLimits
+{
+public:
+    float fullScale;        // measurement units
+    float jump;             // measurement units, between one sample and the next
+    int   stuckSamples;     // identical samples in a row on one axis
+    bool  checkHeaderCount; // whether "C=" is the number of samples in a block
+    int   countTolerance;   // samples a block may be short of the file's most common length
+    int   heartbeatGap;     // s
+    float vbatMin, vbatMax; // V
+    uint  autoExclude;      // flags that exclude a trace (unless Exclude.sqlite says otherwise)
+};
+
+extern t_QualityLimits &getQualityLimits(void);
+extern t_QualityLimits loadQualityLimits(QDir dir);
+
+extern uint checkSamples(const std::vector<std::array<float,3>> &vals, const t_QualityLimits &limits);
+extern uint checkBlock(t_FileState &state, int samples, const t_QualityLimits &limits);
+extern void checkHeartbeat(t_FileState &state, const t_Extra &extra, const t_QualityLimits &limits);
+extern QString qualityText(uint quality);
+extern QString qualityHelp(void);
+
+#endif // QUALITY_H
@@ -0,0 +1,89 @@
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include "readahead.h"
+
+Q_LOGGING_CATEGORY(lcProfile, "procvib.profile", QtWarningMsg)
+
+// Waiting at either end of a queue: spin briefly, as the other end is usually
+// about to catch up, then sleep so as not to take a core from it.
+static void backOff(int &tries)
+{
+    if (++ tries < 64)
+    {
+        QThread::yieldCurrentThread();
+    }
+    else
+    {
+        QThread::usleep(200);
+    }
+}
+
+t_ReadAhead::t_ReadAhead(const QList<QFileInfo> &fileList) : files(fileList), buffers(Buffers)
+{
+    for (t_ReadBuffer &buffer : buffers)
+    {
+        buffer.data.resize(BufferSize);
+        buffer.size = 0;
+        buffer.last = false;
+        emptyBuffers.push(&buffer);
+    }
+    reader = QtConcurrent::run(this, &t_ReadAhead::run);
+}
+
+t_ReadAhead::~t_ReadAhead()
+{
+    stopping = true;
+    reader.waitForFinished();
+}
+
+void t_ReadAhead::run(void)
+{
+    foreach (QFileInfo fInfo, files)
+    {
+        QFile file(fInfo.filePath());
+        const bool ok = file.open(QIODevice::ReadOnly);
+        bool last = false;
+        while (!last)
+        {
+            t_ReadBuffer *buffer = nullptr;
+            for (int tries = 0; !emptyBuffers.pop(buffer); )
+            {
+                if (stopping)
+                    return;
+                backOff(tries);
+            }
+
+            const qint64 n = ok ? file.read(buffer->data.data(), BufferSize) : 0;
+            buffer->size = static_cast<int>(qMax(n, static_cast<qint64>(0)));
+            last = (n < BufferSize) || file.atEnd();
+            buffer->last = last;
+            bytes += buffer->size;
+
+            fullBuffers.push(buffer);  // never full: there are only as many buffers as places
+        }
+    }
+}
+
+t_ReadBuffer *t_ReadAhead::next(void)
+{
+    t_ReadBuffer *buffer = nullptr;
+    if (!fullBuffers.pop(buffer))
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for (int tries = 0; !fullBuffers.pop(buffer); )
+        {
+            backOff(tries);
+        }
+        parserWait += timer.elapsed();
+    }
+    return buffer;
+}
+
+void t_ReadAhead::release(t_ReadBuffer *buffer)
+{
+    emptyBuffers.push(buffer);
+}
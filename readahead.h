@@ -0,0 +1,86 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <atomic>
+#include <vector>
+
+#include <QFileInfo>
+#include <QFuture>
+#include <QList>
+#include <QLoggingCategory>
+
+// Timings of loading, off unless asked for (batch --profile, or QT_LOGGING_RULES)
+Q_DECLARE_LOGGING_CATEGORY(lcProfile)
+
+// Bounded queue between one producer thread and one consumer thread, without
+// locks: each end only writes its own index.
+template<class T, int N> class t_SpscQueue
+{
+public:
+    bool push(const T &item)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return false;   // full
+        items[t % N] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    bool pop(T &item)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h)
+            return false;   // empty
+        item = items[h % N];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[N];
+    std::atomic<size_t> head{0};    // next to pop
+    std::atomic<size_t> tail{0};    // next to push
+};
+
+// Part of a file, read ahead
+class t_ReadBuffer
+{
+public:
+    std::vector<char> data;     // always BufferSize long
+    int  size;                  // bytes of it read
+    bool last;                  // the end of its file, or the file couldn't be read
+};
+
+// Reads a list of files in order on a thread of its own, into a fixed set of
+// buffers that are handed back when parsed. The reading of one buffer overlaps
+// the parsing of the ones before it, so the parser only waits for the disk
+// when the disk is the slower of the two.
+class t_ReadAhead
+{
+public:
+    static const int BufferSize = 1 << 20;
+    static const int Buffers = 8;
+
+    explicit t_ReadAhead(const QList<QFileInfo> &files);
+    ~t_ReadAhead();
+
+    t_ReadBuffer *next(void);               // the next buffer of the current file
+    void release(t_ReadBuffer *buffer);     // once parsed
+
+    qint64 bytesRead(void) const { return bytes.load(); }
+    qint64 parserWaitMs(void) const { return parserWait; }     // time next() spent waiting for the disk
+
+private:
+    void run(void);
+
+    QList<QFileInfo> files;
+    std::vector<t_ReadBuffer> buffers;
+    t_SpscQueue<t_ReadBuffer *, Buffers> emptyBuffers;  // to the reader
+    t_SpscQueue<t_ReadBuffer *, Buffers> fullBuffers;   // to the parser
+    std::atomic<qint64> bytes{0};
+    std::atomic<bool> stopping{false};
+    qint64 parserWait = 0;
+    QFuture<void> reader;
+};
+
+#endif // READAHEAD_H
@@ -0,0 +1,185 @@
+#include <functional>
+
+#include <QDir>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "loadtrace.h"
+#include "tablewidget.h"
+#include "report.h"
+
+static const QSize PlotSize(1600, 900);
+
+// The first trace of every event that isn't excluded, with a windowed max (or,
+// without windowed maxes, a maximum) of at least minWMax.
+QVector<int> significantEvents(float minWMax)
+{
+    QVector<int> events;
+    t_Trace * p_t;
+    for (int i = 0; (p_t = getTrace(i)) != nullptr; i = eventEnd(i))
+    {
+        float v = (p_t->wMax > 0.0f) ? p_t->wMax : p_t->maximumDeviation;
+        if (p_t->exclusion == 0 && v >= minWMax)
+        {
+            events.push_back(i);
+        }
+    }
+    return events;
+}
+
+// Summary lines shown above the plot
+static QStringList eventSummary(int base)
+{
+    t_Trace * p_t = getTrace(base);
+    QStringList lines;
+    lines << QString("%1  %2  (%3 traces)").arg(p_t->fileName, p_t->dt.toString("dd/MM/yyyy HH:mm:ss")).arg(eventEnd(base) - base);
+    lines << QString("Max. %1   RMS %2   Windowed Max. %3   Dom. freq. %4 Hz")
+                .arg(static_cast<qreal>(p_t->maximumDeviation), 0, 'f', 1)
+                .arg(static_cast<qreal>(p_t->rmsDeviation), 0, 'f', 1)
+                .arg(static_cast<qreal>(p_t->wMax), 0, 'f', 1)
+                .arg(static_cast<qreal>(p_t->dominantFrequency), 0, 'f', 1);
+    return lines;
+}
+
+// Draw the summary and the X/Y/Z plot of one event onto an image. Only QImage
+// and QPainter are used, so this can run on any thread and needs no display.
+QImage renderEvent(int base, QSize size)
+{
+    QImage image(size, QImage::Format_RGB32);
+    image.fill(Qt::white);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    QFont font = painter.font();
+    font.setPixelSize(size.height()/40);
+    painter.setFont(font);
+    int lineHeight = painter.fontMetrics().height();
+
+    QStringList summary = eventSummary(base);
+    for (int l = 0; l < summary.size(); l ++)
+    {
+        painter.drawText(lineHeight, lineHeight*(l + 1), summary.at(l));
+    }
+
+    QRect plot(lineHeight*5, lineHeight*(summary.size() + 1), size.width() - lineHeight*6, size.height() - lineHeight*(summary.size() + 3));
+
+    // Decimated series of every trace in the event, on one time axis. Each
+    // axis is drawn about its own mean, so all three fit on one scale.
+    const QColor colours[3] = {QColor(0x20, 0x9f, 0xdf), QColor(0x99, 0xca, 0x53), QColor(0xf6, 0xa6, 0x25)};
+    QVector<QVector<QPointF>> series[3];
+    qreal tMax = 0., yMin = 0., yMax = 0.;
+    t_Trace * p_base = getTrace(base);
+    for (int i = base, end = eventEnd(base); i < end; i ++)
+    {
+        t_Trace * p_t = getTrace(i);
+        qreal t0 = static_cast<qreal>(p_base->dt.msecsTo(p_t->dt))/1000.;
+        for (unsigned int n = 0; n < 3; n ++)
+        {
+            QVector<QPointF> points = traceSeries(*p_t, n, t0, qMax(16, plot.width()*2/(end - base)));
+            qreal mean = 0.;
+            foreach (const QPointF &p, points)
+            {
+                mean += p.y();
+            }
+            mean /= qMax(points.size(), 1);
+            for (int k = 0; k < points.size(); k ++)
+            {
+                points[k].setY(points.at(k).y() - mean);
+                yMin = qMin(yMin, points.at(k).y());
+                yMax = qMax(yMax, points.at(k).y());
+                tMax = qMax(tMax, points.at(k).x());
+            }
+            series[n].push_back(points);
+        }
+    }
+    if (tMax <= 0.)
+        tMax = 1.;
+    if (yMax <= yMin)
+        yMax = yMin + 1.;
+
+    // Axes and labels
+    painter.setPen(Qt::gray);
+    painter.drawRect(plot);
+    qreal y0 = plot.bottom() - (0. - yMin)/(yMax - yMin)*plot.height();
+    painter.drawLine(QPointF(plot.left(), y0), QPointF(plot.right(), y0));
+    painter.setPen(Qt::black);
+    painter.drawText(QRect(plot.left(), plot.bottom(), plot.width(), lineHeight*2), Qt::AlignCenter, QString("Time [s] (0 to %1)").arg(tMax, 0, 'f', 2));
+    painter.drawText(QRect(0, plot.top(), plot.left(), lineHeight), Qt::AlignRight, QString::number(yMax, 'f', 4));
+    painter.drawText(QRect(0, plot.bottom() - lineHeight, plot.left(), lineHeight), Qt::AlignRight, QString::number(yMin, 'f', 4));
+
+    const char * const names[3] = {"X", "Y", "Z"};
+    for (int n = 0; n < 3; n ++)
+    {
+        painter.setPen(QPen(colours[n], 1.5));
+        foreach (const QVector<QPointF> &points, series[n])
+        {
+            QPolygonF line;
+            line.reserve(points.size());
+            foreach (const QPointF &p, points)
+            {
+                line << QPointF(plot.left() + p.x()/tMax*plot.width(),
+                                plot.bottom() - (p.y() - yMin)/(yMax - yMin)*plot.height());
+            }
+            painter.drawPolyline(line);
+        }
+        painter.drawText(plot.right() - lineHeight*(3 - n)*2, plot.top() + lineHeight, names[n]);
+    }
+
+    return image;
+}
+
+bool writeReport(QString path, const QVector<int> &events)
+{
+    // Render the events across the thread pool, a pool's worth at a time, and write
+    // each chunk of images out before rendering the next, so memory stays bounded.
+    std::function<QImage(const int &)> render = [](const int &base) { return renderEvent(base, PlotSize); };
+    const int chunk = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+
+    if (path.endsWith(".pdf", Qt::CaseInsensitive))
+    {
+        QPdfWriter pdf(path);
+        pdf.setPageSize(QPageSize(QPageSize::A4));
+        pdf.setPageOrientation(QPageLayout::Landscape);
+        pdf.setResolution(150);
+
+        QPainter painter;
+        if (!painter.begin(&pdf))
+            return false;
+        for (int start = 0; start < events.size(); start += chunk)
+        {
+            QVector<QImage> images = QtConcurrent::blockingMapped<QVector<QImage>>(events.mid(start, chunk), render);
+            for (int i = 0; i < images.size(); i ++)
+            {
+                if (start + i > 0)
+                {
+                    pdf.newPage();
+                }
+                QRect page = painter.viewport();
+                QSize fit = images.at(i).size().scaled(page.size(), Qt::KeepAspectRatio);
+                painter.drawImage(QRect(page.topLeft(), fit), images.at(i));
+            }
+        }
+        painter.end();
+        return true;
+    }
+    else
+    {
+        QDir dir(path);
+        if (!dir.exists() && !dir.mkpath("."))
+            return false;
+        bool ok = true;
+        for (int start = 0; start < events.size(); start += chunk)
+        {
+            QVector<QImage> images = QtConcurrent::blockingMapped<QVector<QImage>>(events.mid(start, chunk), render);
+            for (int i = 0; i < images.size(); i ++)
+            {
+                t_Trace * p_t = getTrace(events.at(start + i));
+                ok = images.at(i).save(dir.filePath(QString("event_%1_%2.png").arg(start + i + 1, 4, 10, QChar('0')).arg(p_t->dt.toString("yyyyMMdd_HHmmss")))) && ok;
+            }
+        }
+        return ok;
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+// One page per event: its summary values, then its X/Y/Z plot. "events" are the
+// indexes of the first traces of the events. Written as a PDF if "path" ends in
+// ".pdf", otherwise as one PNG per event in the directory "path".
+extern bool writeReport(QString path, const QVector<int> &events);
+
+extern QVector<int> significantEvents(float minWMax);
+extern QImage renderEvent(int base, QSize size);
+
+#endif // REPORT_H
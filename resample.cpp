@@ -0,0 +1,161 @@
+#include <QtMath>
+
+#include "resample.h"
+
+t_Resampler::t_Resampler(int upFactor, int downFactor, int tapsPerPhase)
+    : up(upFactor), down(downFactor), taps(tapsPerPhase*qMax(1, (downFactor + upFactor - 1)/upFactor))
+{
+    // Windowed-sinc low pass at the lower of the two Nyquist frequencies (less a
+    // margin for the transition band), designed at the up-sampled rate.
+    // An odd length keeps the delay a whole number of samples; any spare tap is zero.
+    int n = taps*up;
+    int len = (n % 2 == 0) ? n - 1 : n;
+    qreal fc = 0.45/static_cast<qreal>(qMax(up, down));
+    std::vector<qreal> h(static_cast<size_t>(n), 0.);
+    qreal sum = 0.;
+    for (int k = 0; k < len; k ++)
+    {
+        qreal x = static_cast<qreal>(k - (len - 1)/2);
+        qreal sinc = (x == 0.) ? 2.*fc : qSin(2.*M_PI*fc*x)/(M_PI*x);
+        qreal w = 0.42 - 0.5*qCos(2.*M_PI*k/(len - 1)) + 0.08*qCos(4.*M_PI*k/(len - 1));
+        h[static_cast<size_t>(k)] = sinc*w;
+        sum += sinc*w;
+    }
+
+    // Split into phases, scaled for unity gain after the zero stuffing
+    coeffs.resize(static_cast<size_t>(n));
+    for (int p = 0; p < up; p ++)
+    {
+        for (int q = 0; q < taps; q ++)
+        {
+            coeffs[static_cast<size_t>(p*taps + q)] = static_cast<float>(h[static_cast<size_t>(p + q*up)]*up/sum);
+        }
+    }
+    delay = (len - 1)/2;
+
+    history.resize(static_cast<size_t>(2*taps));
+    std::array<float,3> zero = {{0.0f, 0.0f, 0.0f}};
+    reset(zero);
+}
+
+void t_Resampler::reset(const std::array<float,3> &first)
+{
+    std::fill(history.begin(), history.end(), first);
+    pos = 0;
+    newest = -1;
+    nextT = delay;      // so that output 0 lines up with input 0
+}
+
+int t_Resampler::push(const std::array<float,3> &in, std::array<float,3> *out)
+{
+    history[static_cast<size_t>(pos)] = in;
+    history[static_cast<size_t>(pos + taps)] = in;
+    pos = (pos + 1 == taps) ? 0 : pos + 1;
+    newest ++;
+
+    int count = 0;
+    while (nextT/up <= newest)
+    {
+        // Output at up-sampled time nextT uses phase nextT % up, applied to the
+        // inputs going back from the newest.
+        const float *c = &coeffs[static_cast<size_t>((nextT % up)*taps)];
+        const std::array<float,3> *x = &history[static_cast<size_t>(pos + taps - 1)];
+        float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+        for (int q = 0; q < taps; q ++)
+        {
+            sx += c[q]*x[-q][0];
+            sy += c[q]*x[-q][1];
+            sz += c[q]*x[-q][2];
+        }
+        out[count][0] = sx;
+        out[count][1] = sy;
+        out[count][2] = sz;
+        count ++;
+        nextT += down;
+    }
+    return count;
+}
+
+static float ResampleFrequency = 0.0f;
+
+void setResampleFrequency(float hz)
+{
+    ResampleFrequency = hz;
+}
+
+float resampleFrequency(void)
+{
+    return ResampleFrequency;
+}
+
+static int gcd(int a, int b)
+{
+    while (b != 0)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+void t_Resamplers::clear(void)
+{
+    qDeleteAll(resamplers);
+    resamplers.clear();
+    resampled.clear();
+}
+
+t_Resampler &t_Resamplers::forRatio(int up, int down)
+{
+    QPair<int,int> key(up, down);
+    if (!resamplers.contains(key))
+    {
+        resamplers.insert(key, new t_Resampler(up, down));
+    }
+    return *resamplers.value(key);
+}
+
+// Resample one block of samples to the common frequency, if one is set. Blocks
+// are not continuous with each other, so the filter starts afresh for each.
+// A ratio of rates needing more than 64 steps up or down is left as it is.
+void resampleTrace(std::vector<std::array<float,3>> &vals, float &frequency, t_Resamplers &resamplers)
+{
+    if (ResampleFrequency <= 0.0f || vals.empty())
+        return;
+
+    // Rates to the nearest 0.01 Hz, as they're written in the files
+    int from = qRound(frequency*100.0f);
+    int to = qRound(ResampleFrequency*100.0f);
+    if (from <= 0 || from == to)
+        return;
+    int g = gcd(from, to);
+    int up = to/g;
+    int down = from/g;
+    if (up > 64 || down > 64)
+    {
+        return;     // not a simple enough ratio to be worth doing
+    }
+
+    t_Resampler &r = resamplers.forRatio(up, down);
+    std::vector<std::array<float,3>> &resampled = resamplers.resampled;
+
+    size_t wanted = (vals.size()*static_cast<size_t>(up) + static_cast<size_t>(down) - 1)/static_cast<size_t>(down);
+    resampled.resize(wanted + static_cast<size_t>(r.maxOutputs()));   // allocates only if the buffer swapped in last time is too small
+
+    r.reset(vals.front());
+    size_t n = 0;
+    for (size_t i = 0; i < vals.size(); i ++)
+    {
+        n += static_cast<size_t>(r.push(vals[i], &resampled[n]));
+    }
+    for (int i = 0; i < r.delayInputs() && n < wanted; i ++)
+    {
+        n += static_cast<size_t>(r.push(vals.back(), &resampled[n]));
+    }
+
+    // The block takes the output buffer, and its own buffer is written to next time
+    resampled.resize(qMin(n, wanted));
+    vals.swap(resampled);
+    frequency = ResampleFrequency;
+}
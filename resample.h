@@ -0,0 +1,66 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <array>
+#include <vector>
+
+#include <QMap>
+#include <QPair>
+#include <QtGlobal>
+
+// Streaming polyphase resampler by a rational factor up/down, working on all
+// three axes at once. All of its memory is allocated when it's made, so pushing
+// samples through it never allocates. When decimating, the taps per phase are
+// scaled by down/up so the filter still spans the same number of cycles of its
+// (lower) cut-off.
+class t_Resampler
+{
+public:
+    t_Resampler(int up, int down, int tapsPerPhase = 16);
+
+    // Start a new block, as if the signal had been "first" for ever before it
+    void reset(const std::array<float,3> &first);
+
+    // Push one input sample. Writes any outputs that became available (at most
+    // maxOutputs()) to "out" and returns how many.
+    int push(const std::array<float,3> &in, std::array<float,3> *out);
+
+    int maxOutputs(void) const { return (up + down - 1)/down; }
+    int delayInputs(void) const { return (delay + up - 1)/up; }  // inputs needed to flush the filter
+
+    const int up;
+    const int down;
+
+private:
+    const int taps;                 // per phase
+    int       delay;                // group delay, in up-sampled samples
+    std::vector<float> coeffs;      // coeffs[phase*taps + q]
+    std::vector<std::array<float,3>> history;   // last "taps" inputs, stored twice over so no wrapping is needed
+    int    pos;
+    qint64 newest;                  // index of the newest input
+    qint64 nextT;                   // next output time, in up-sampled samples
+};
+
+// The resamplers of one load, one for each ratio of rates met, and the buffer
+// they write to. Not to be shared between threads.
+class t_Resamplers
+{
+public:
+    t_Resamplers(void) {}
+    ~t_Resamplers(void) { clear(); }
+
+    void clear(void);
+    t_Resampler &forRatio(int up, int down);
+
+    std::vector<std::array<float,3>> resampled;
+
+private:
+    Q_DISABLE_COPY(t_Resamplers)
+    QMap<QPair<int,int>, t_Resampler *> resamplers;
+};
+
+extern void setResampleFrequency(float hz);     // 0 for no resampling
+extern float resampleFrequency(void);
+extern void resampleTrace(std::vector<std::array<float,3>> &vals, float &frequency, t_Resamplers &resamplers);
+
+#endif // RESAMPLE_H
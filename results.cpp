@@ -0,0 +1,159 @@
+#include <QTextStream>
+
+#include "loadtrace.h"
+#include "exceedance.h"
+#include "spectrum.h"
+#include "quality.h"
+#include "distributions.h"
+#include "results.h"
+
+// The tables of the post-processed output are written a row at a time, so that
+// the streaming path (stream.cpp) produces exactly the same output.
+
+void writeTraceHeader(QTextStream &out, bool saveWithWindowedMax)
+{
+    out << "File name,Date/time,Max., RMS,";
+    if (saveWithWindowedMax)
+    {
+        out << "Windowed Max.,";
+    }
+    out << "Dom. freq. [Hz],";
+    for (int b = 0; b < NumBands; b ++)
+    {
+        out << "RMS " << BandEdges[b] << "-";
+        if (b + 1 < NumBands)
+        {
+            out << BandEdges[b + 1];
+        }
+        out << " Hz,";
+    }
+    out << "Quality,Excluded?" << "\n";
+}
+
+void writeTraceRow(QTextStream &out, const t_Trace &trace, bool saveWithWindowedMax)
+{
+    out << trace.fileName
+        << "," << trace.dt.toString("dd/MM/yyyy HH:mm:ss")
+        << "," << QString::number(static_cast<qreal>(trace.maximumDeviation))
+        << "," << QString::number(static_cast<qreal>(trace.rmsDeviation));
+    if (saveWithWindowedMax)
+    {
+        out << "," << QString::number(static_cast<qreal>(trace.wMax));
+    }
+    out << "," << QString::number(static_cast<qreal>(trace.dominantFrequency));
+    for (int b = 0; b < NumBands; b ++)
+    {
+        out << "," << QString::number(static_cast<qreal>(trace.bandRms[b]));
+    }
+    out << "," << qualityText(trace.quality) << ",";
+    if (trace.exclusion > 0)
+    {
+        out << "X";
+    }
+    // else nothing...
+    out << "\n";
+}
+
+void writeVdvTable(QTextStream &out, const t_VDVs &vs)
+{
+    out << "Start,End,VDV [m s^-1.75]" << "\n";
+    for(int endj = vs.size(), j = 0; j < endj; j ++)
+    {
+        out << vs[j].start.toString("dd/MM/yyyy HH:mm:ss")
+            << "," << vs[j].end.toString("dd/MM/yyyy HH:mm:ss")
+            << "," << QString::number(static_cast<qreal>(vs[j].total_VDV)) << "\n";
+    }
+}
+
+void writeExtraHeader(QTextStream &out)
+{
+    out << "File name,Date/time,Type,V_bat [V],Temp 1 [degC],Temp2 [degC],Temp3 [degC]" << "\n";
+}
+
+void writeExtraRow(QTextStream &out, const t_Extra &extra)
+{
+    out << extra.fileName
+        << "," << extra.dt.toString("dd/MM/yyyy HH:mm:ss");
+    if (extra.type == t_ExtraType::Heartbeat)
+    {
+        out << ",HEARTBEAT";
+    }
+    else if (extra.type == t_ExtraType::On)
+    {
+        out << ",ON";
+    }
+    else
+    {
+        out << ",";
+    }
+
+    out << "," << QString::number(static_cast<qreal>(extra.v_bat))
+        << "," << QString::number(static_cast<qreal>(extra.temp_1))
+        << "," << QString::number(static_cast<qreal>(extra.temp_2))
+        << ",";
+    if (extra.temp_3 != -1.0)  // comparison with float -- not good!
+    {
+        out << "," << QString::number(static_cast<qreal>(extra.temp_3));
+    }
+    out << "\n";
+}
+
+void writeExceedanceHeader(QTextStream &out)
+{
+    out << "File name,Date/time,Axis,Threshold,Duration [s],Peak,Excluded?" << "\n";
+}
+
+void writeExceedanceRow(QTextStream &out, const t_Exceedance &e, const t_Trace &trace)
+{
+    const t_ExceedanceScanner &scanner = getExceedanceScanner();
+    const char * const channelNames[ExcNumChannels] = {"X", "Y", "Z", "Vector"};
+    out << trace.fileName
+        << "," << e.startTime(trace.dt, trace.frequency).toString("dd/MM/yyyy HH:mm:ss.zzz")
+        << "," << channelNames[e.channel]
+        << "," << QString::number(static_cast<qreal>(scanner.levels().at(e.level).threshold))
+        << "," << QString::number(static_cast<qreal>(e.samples)/static_cast<qreal>(trace.frequency))
+        << "," << QString::number(static_cast<qreal>(e.peak))
+        << ",";
+    if (trace.exclusion > 0)
+    {
+        out << "X";
+    }
+    out << "\n";
+}
+
+// Write the post-processed output: one row per trace, then the VDV periods,
+// the heartbeat information, the threshold exceedances and the distributions.
+void writeResults(QTextStream &out, bool saveWithWindowedMax)
+{
+    writeTraceHeader(out, saveWithWindowedMax);
+    int i = 0;
+    t_Trace * p_t;
+    while ((p_t = getTrace(i)) != nullptr)
+    {
+        writeTraceRow(out, *p_t, saveWithWindowedMax);
+        i ++;
+    }
+
+    // VDV values are kept up to date as traces are loaded and excluded
+    writeVdvTable(out, currentVdv());
+
+    // Now output heartbeat information
+    writeExtraHeader(out);
+    t_Extra extra;
+    for (i = 0; getExtra(i, extra); i ++)
+    {
+        writeExtraRow(out, extra);
+    }
+
+    // Now output threshold exceedances
+    writeExceedanceHeader(out);
+    foreach (const t_Exceedance &e, getExceedanceScanner().exceedances())
+    {
+        p_t = getTrace(e.trace);
+        if (p_t == nullptr)
+            continue;
+        writeExceedanceRow(out, e, *p_t);
+    }
+
+    writeDistributions(out, distributionsOf());
+}
@@ -0,0 +1,19 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <QTextStream>
+
+#include "loadtrace.h"
+#include "exceedance.h"
+
+extern void writeResults(QTextStream &out, bool saveWithWindowedMax);
+
+extern void writeTraceHeader(QTextStream &out, bool saveWithWindowedMax);
+extern void writeTraceRow(QTextStream &out, const t_Trace &trace, bool saveWithWindowedMax);
+extern void writeVdvTable(QTextStream &out, const t_VDVs &vs);
+extern void writeExtraHeader(QTextStream &out);
+extern void writeExtraRow(QTextStream &out, const t_Extra &extra);
+extern void writeExceedanceHeader(QTextStream &out);
+extern void writeExceedanceRow(QTextStream &out, const t_Exceedance &e, const t_Trace &trace);
+
+#endif // RESULTS_H
@@ -0,0 +1,360 @@
+#include <algorithm>
+
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include "loadtrace.h"
+#include "telemetry.h"
+#include "summaries.h"
+#include "quality.h"
+#include "rules.h"
+
+#include "sql/connection.h"
+
+/*
+    Rules are written one to a line, as a name and the conditions that must
+    all hold for a trace to be excluded, separated by ";":
+
+        # comment
+        working-hours: hours 08:00-18:00; weekdays
+        small-z: axis Z; RMS < 50
+        after-reset: within 30 s of ON
+        before-install: to 2019-07-29 12:00:00
+
+    The conditions are
+        <column> <op> <value>       column as for --column, op one of < <= > >= =
+        axis X|Y|Z
+        hours HH:mm-HH:mm
+        weekdays | weekends | days Mon,Tue,...
+        from | to yyyy-MM-dd HH:mm:ss
+        within <n> s of ON|HEARTBEAT
+    The windowed max (wMax) is held by the first trace of each event only.
+*/
+
+static const char * const DayNames[7] = {"sun", "mon", "tue", "wed", "thu", "fri", "sat"};
+
+static bool parseTimeOfDay(const QString &s, int &secs)
+{
+    QTime t = QTime::fromString(s.trimmed(), "HH:mm");
+    if (!t.isValid())
+        return false;
+    secs = t.msecsSinceStartOfDay()/1000;
+    return true;
+}
+
+static bool parseCondition(const QString &text, t_RuleCondition &c)
+{
+    QStringList w = text.simplified().split(' ');
+    if (w.isEmpty() || w.at(0).isEmpty())
+        return false;
+
+    QString key = w.at(0).toLower();
+    if (key == "axis" && w.size() == 2)
+    {
+        int axis = QString("xyz").indexOf(w.at(1).toLower());
+        if (axis < 0 || w.at(1).size() != 1)
+            return false;
+        c.kind = t_RuleCondition::Compare;
+        c.column = ColMaxAxis;
+        c.op = '=';
+        c.value = static_cast<float>(axis);
+        return true;
+    }
+    if (key == "hours" && w.size() == 2)
+    {
+        QStringList range = w.at(1).split('-');
+        c.kind = t_RuleCondition::Hours;
+        return range.size() == 2 && parseTimeOfDay(range.at(0), c.from) && parseTimeOfDay(range.at(1), c.to);
+    }
+    if ((key == "weekdays" || key == "weekends") && w.size() == 1)
+    {
+        c.kind = t_RuleCondition::Days;
+        c.dayMask = (key == "weekdays") ? 0x3E : 0x41;
+        return true;
+    }
+    if (key == "days" && w.size() == 2)
+    {
+        c.kind = t_RuleCondition::Days;
+        c.dayMask = 0;
+        foreach (QString d, w.at(1).toLower().split(','))
+        {
+            int day = -1;
+            for (int k = 0; k < 7; k ++)
+            {
+                if (d == DayNames[k])
+                {
+                    day = k;
+                }
+            }
+            if (day < 0)
+                return false;
+            c.dayMask |= (1u << day);
+        }
+        return true;
+    }
+    if ((key == "from" || key == "to") && w.size() == 3)
+    {
+        QDateTime dt = QDateTime::fromString(w.at(1) + " " + w.at(2), "yyyy-MM-dd HH:mm:ss");
+        dt.setTimeSpec(Qt::UTC);
+        c.kind = (key == "from") ? t_RuleCondition::After : t_RuleCondition::Before;
+        c.time = dt.toMSecsSinceEpoch();
+        return dt.isValid();
+    }
+    if (key == "within" && w.size() == 5 && w.at(2) == "s" && w.at(3).toLower() == "of")
+    {
+        bool ok;
+        c.kind = t_RuleCondition::Near;
+        c.within = qRound64(1000.0*w.at(1).toDouble(&ok));
+        if (w.at(4).toUpper() == "ON")
+        {
+            c.extraType = t_ExtraType::On;
+        }
+        else if (w.at(4).toUpper() == "HEARTBEAT")
+        {
+            c.extraType = t_ExtraType::Heartbeat;
+        }
+        else
+        {
+            return false;
+        }
+        return ok;
+    }
+    if (w.size() == 3 && summaryColumnFromName(w.at(0)) >= 0)
+    {
+        const QStringList ops = QStringList() << "<" << "<=" << ">" << ">=" << "=";
+        const char opCodes[] = {'<', 'l', '>', 'g', '='};
+        int op = ops.indexOf(w.at(1));
+        bool ok;
+        c.kind = t_RuleCondition::Compare;
+        c.column = summaryColumnFromName(w.at(0));
+        c.value = w.at(2).toFloat(&ok);
+        if (op < 0)
+            return false;
+        c.op = opCodes[op];
+        return ok;
+    }
+    return false;
+}
+
+bool parseExclusionRules(const QString &text, t_ExclusionRules &rules, QString &error)
+{
+    rules.clear();
+    QStringList lines = text.split('\n');
+    for (int n = 0; n < lines.size(); n ++)
+    {
+        QString line = lines.at(n).trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        int colon = line.indexOf(':');
+        if (colon <= 0)
+        {
+            error = QString("Line %1: no rule name").arg(n + 1);
+            return false;
+        }
+        t_ExclusionRule rule;
+        rule.name = line.left(colon).trimmed();
+        foreach (QString condition, line.mid(colon + 1).split(';'))
+        {
+            t_RuleCondition c;
+            if (!parseCondition(condition, c))
+            {
+                error = QString("Line %1: can't understand \"%2\"").arg(n + 1).arg(condition.trimmed());
+                return false;
+            }
+            rule.conditions.push_back(c);
+        }
+        rules.push_back(rule);
+    }
+    return true;
+}
+
+bool loadExclusionRules(const QString &path, t_ExclusionRules &rules, QString &error)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly | QFile::Text))
+    {
+        error = QString("Can't open %1").arg(path);
+        return false;
+    }
+    return parseExclusionRules(QTextStream(&file).readAll(), rules, error);
+}
+
+// mask[i] &= pred(i), over every trace
+template <typename Pred>
+static void andWhere(QVector<quint8> &mask, Pred pred)
+{
+    quint8 * m = mask.data();
+    for (int end = mask.size(), i = 0; i < end; i ++)
+    {
+        m[i] &= static_cast<quint8>(pred(i));
+    }
+}
+
+static void applyCondition(QVector<quint8> &mask, const t_RuleCondition &c, const t_Summaries &s)
+{
+    const qint64 * t = s.time.constData();
+    switch (c.kind)
+    {
+    case t_RuleCondition::Compare:
+    {
+        const float * v = s.cols[c.column].constData();
+        const float x = c.value;
+        switch (c.op)
+        {
+        case '<': andWhere(mask, [=](int i) { return v[i] <  x; }); break;
+        case 'l': andWhere(mask, [=](int i) { return v[i] <= x; }); break;
+        case '>': andWhere(mask, [=](int i) { return v[i] >  x; }); break;
+        case 'g': andWhere(mask, [=](int i) { return v[i] >= x; }); break;
+        default:  andWhere(mask, [=](int i) { return v[i] == x; }); break;
+        }
+        break;
+    }
+    case t_RuleCondition::Hours:
+    {
+        const qint64 from = 1000*static_cast<qint64>(c.from);
+        const qint64 to = 1000*static_cast<qint64>(c.to);
+        if (from <= to)
+        {
+            andWhere(mask, [=](int i) { qint64 d = ((t[i] % 86400000) + 86400000) % 86400000; return d >= from && d < to; });
+        }
+        else
+        {
+            andWhere(mask, [=](int i) { qint64 d = ((t[i] % 86400000) + 86400000) % 86400000; return d >= from || d < to; });
+        }
+        break;
+    }
+    case t_RuleCondition::Days:
+    {
+        const quint8 days = c.dayMask;
+        // 1/1/1970 was a Thursday
+        andWhere(mask, [=](int i) { qint64 d = ((t[i]/86400000 + 4) % 7 + 7) % 7; return (days >> d) & 1; });
+        break;
+    }
+    case t_RuleCondition::After:
+    {
+        const qint64 from = c.time;
+        andWhere(mask, [=](int i) { return t[i] >= from; });
+        break;
+    }
+    case t_RuleCondition::Before:
+    {
+        const qint64 to = c.time;
+        andWhere(mask, [=](int i) { return t[i] <= to; });
+        break;
+    }
+    case t_RuleCondition::Near:
+    {
+        const t_Telemetry &tel = getTelemetry();
+        QVector<qint64> times;
+        for (int r = 0; r < tel.size(); r ++)
+        {
+            if (tel.type.at(r) == c.extraType)
+            {
+                times.push_back(tel.time.at(r));
+            }
+        }
+        std::sort(times.begin(), times.end());
+        const qint64 within = c.within;
+        const qint64 * begin = times.constData();
+        const qint64 * end = begin + times.size();
+        andWhere(mask, [=](int i)
+        {
+            const qint64 * p = std::lower_bound(begin, end, t[i] - within);
+            return p != end && *p <= t[i] + within;
+        });
+        break;
+    }
+    }
+}
+
+// For each trace, the index of the first rule it matches, or -1. Traces already
+// excluded (other than for their quality) are left alone.
+QVector<int> matchExclusionRules(const t_ExclusionRules &rules)
+{
+    const t_Summaries &s = getSummaries();
+    QVector<int> matched(s.size(), -1);
+
+    for (int r = rules.size() - 1; r >= 0; r --)     // so that the first rule matching wins
+    {
+        QVector<quint8> mask(s.size(), 1);
+        foreach (const t_RuleCondition &c, rules.at(r).conditions)
+        {
+            applyCondition(mask, c, s);
+        }
+        for (int i = 0; i < s.size(); i ++)
+        {
+            if (mask.at(i))
+            {
+                matched[i] = r;
+            }
+        }
+    }
+
+    for (int i = 0; i < s.size(); i ++)
+    {
+        if (s.exclusion.at(i) > 0 && s.exclusion.at(i) != QualityExclusion)
+        {
+            matched[i] = -1;
+        }
+    }
+    return matched;
+}
+
+// Exclude the traces that the rules match, recording each with the name of the
+// rule in Exclude.sqlite (all in one transaction). Returns how many were
+// excluded, or -1 if the database couldn't be opened.
+int applyExclusionRules(QDir dir, const t_ExclusionRules &rules)
+{
+    QVector<int> matched = matchExclusionRules(rules);
+    if (!createConnection(dir))
+        return -1;
+
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+
+    QSqlQuery find, update, insert;
+    find.prepare("select id from trace where (filename=:filename and datetime=:datetime)");
+    update.prepare("update trace set exclusion=:k, rule=:rule where id=:id");
+    insert.prepare("insert into trace (filename, datetime, exclusion, rule) values (:filename, :datetime, :k, :rule)");
+
+    QVector<int> excluded;
+    for (int i = 0; i < matched.size(); i ++)
+    {
+        if (matched.at(i) < 0)
+            continue;
+
+        const t_Trace * p_t = getTrace(i);
+        const QString &rule = rules.at(matched.at(i)).name;
+        find.bindValue(":filename", p_t->fileName);
+        find.bindValue(":datetime", p_t->dt.toSecsSinceEpoch());
+        find.exec();
+        if (find.first())
+        {
+            update.bindValue(":k", RuleExclusion);
+            update.bindValue(":rule", rule);
+            update.bindValue(":id", find.value(0).toInt());
+            update.exec();
+        }
+        else
+        {
+            insert.bindValue(":filename", p_t->fileName);
+            insert.bindValue(":datetime", p_t->dt.toSecsSinceEpoch());
+            insert.bindValue(":k", RuleExclusion);
+            insert.bindValue(":rule", rule);
+            insert.exec();
+        }
+        excluded.push_back(i);
+    }
+
+    if (!db.commit())
+    {
+        db.rollback();
+        return -1;
+    }
+
+    // Only now that they're recorded, update the traces and what depends on them
+    setExclusions(excluded, RuleExclusion);
+    return excluded.size();
+}
@@ -0,0 +1,50 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <QDir>
+#include <QString>
+#include <QVector>
+
+// One condition of an exclusion rule. See rules.cpp for how they're written.
+class t_RuleCondition
+{
+public:
+    typedef enum
+    {
+        Compare,        // column op value
+        Hours,          // time of day, in [from, to) (wrapping past midnight if from > to)
+        Days,           // day of the week, in dayMask
+        After,          // at or after time
+        Before,         // at or before time
+        Near            // within "within" of an extra of type "extraType"
+    } t_Kind;
+
+    t_Kind  kind;
+    int     column;     // t_SummaryColumn
+    char    op;         // '<', 'l' (<=), '>', 'g' (>=), '='
+    float   value;
+    int     from, to;   // s since midnight
+    quint8  dayMask;    // bit 0 is Sunday
+    qint64  time;       // ms since epoch, UTC
+    int     extraType;  // t_ExtraType
+    qint64  within;     // ms
+};
+
+class t_ExclusionRule
+{
+public:
+    QString name;
+    QVector<t_RuleCondition> conditions;   // all of them must hold
+};
+
+typedef QVector<t_ExclusionRule> t_ExclusionRules;
+
+// Exclusion class given to traces matched by a rule
+const uint RuleExclusion = 1;
+
+extern bool parseExclusionRules(const QString &text, t_ExclusionRules &rules, QString &error);
+extern bool loadExclusionRules(const QString &path, t_ExclusionRules &rules, QString &error);
+extern QVector<int> matchExclusionRules(const t_ExclusionRules &rules);
+extern int  applyExclusionRules(QDir dir, const t_ExclusionRules &rules);
+
+#endif // RULES_H
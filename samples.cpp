@@ -0,0 +1,62 @@
+#include <QtMath>
+
+#include "samples.h"
+
+static bool CompactSamples = false;
+
+void setCompactSamples(bool on)
+{
+    CompactSamples = on;
+}
+
+bool compactSamples(void)
+{
+    return CompactSamples;
+}
+
+// Pack samples in counts, as read from the file. Fails, leaving "packed" empty,
+// unless every value is a whole number of LSBs that converts back to the same
+// float, and every axis spans no more than 65535 LSBs. Resampled traces, for
+// one, are held as floats.
+bool packSamples(const std::vector<std::array<float,3>> &counts, t_PackedSamples &packed)
+{
+    packed = t_PackedSamples();
+
+    const size_t n = counts.size();
+    std::vector<std::array<qint32,3>> lsbs(n);
+    qint32 lo[3] = {0, 0, 0}, hi[3] = {0, 0, 0};
+    for (size_t i = 0; i < n; i ++)
+    {
+        for (int a = 0; a < 3; a ++)
+        {
+            const float v = counts[i][a];
+            if (!(qAbs(v) < 1.e8f))     // also false for NaN
+                return false;
+            const qint32 q = qRound(static_cast<double>(v)/SampleLsb);
+            if (static_cast<float>(q*SampleLsb) != v)
+                return false;
+            lsbs[i][a] = q;
+            lo[a] = (i == 0) ? q : qMin(lo[a], q);
+            hi[a] = (i == 0) ? q : qMax(hi[a], q);
+        }
+    }
+    for (int a = 0; a < 3; a ++)
+    {
+        if (hi[a] - lo[a] > 65535)
+            return false;
+    }
+
+    for (int a = 0; a < 3; a ++)
+    {
+        packed.offset[a] = lo[a] + 32768;
+    }
+    packed.narrow.resize(n);
+    for (size_t i = 0; i < n; i ++)
+    {
+        for (int a = 0; a < 3; a ++)
+        {
+            packed.narrow[i][a] = static_cast<qint16>(lsbs[i][a] - packed.offset[a]);
+        }
+    }
+    return true;
+}
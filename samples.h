@@ -0,0 +1,30 @@
+#ifndef SAMPLES_H
+#define SAMPLES_H
+
+#include <array>
+#include <vector>
+
+#include <QtGlobal>
+
+// The logger writes each sample as a whole number of ADXL355 LSBs of 0.064
+// counts. Held as 16 bit integers from an offset, a trace takes half the memory
+// of floats and gives back exactly the same floats. 32 bit integers would save
+// nothing over floats, so traces spanning too many LSBs are left as floats.
+// Products are taken in double and then rounded to float, which matches the
+// floats read from the logger's text. Converting back costs time on every pass
+// over the samples (about 3 ns a sample at -O2), so it's off unless asked for.
+static const double SampleLsb = 0.064;                  // counts
+static const double SampleScale = SampleLsb/16384.;     // g, the normalised value of one LSB
+
+class t_PackedSamples
+{
+public:
+    std::vector<std::array<qint16,3>> narrow;   // LSBs from "offset"
+    std::array<qint32,3> offset;
+};
+
+extern void setCompactSamples(bool on);         // off (the default) to hold floats
+extern bool compactSamples(void);
+extern bool packSamples(const std::vector<std::array<float,3>> &counts, t_PackedSamples &packed);
+
+#endif // SAMPLES_H
@@ -0,0 +1,222 @@
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtMath>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "spectrum.h"
+
+t_FftPlan::t_FftPlan(int length)
+{
+    n = length;
+
+    int bits = 0;
+    while ((1 << bits) < n)
+    {
+        bits ++;
+    }
+    bitrev.resize(n);
+    for (int i = 0; i < n; i ++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b ++)
+        {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bitrev[i] = r;
+    }
+
+    // Each stage's twiddle factors in the order its butterflies use them, so that
+    // they're read with unit stride
+    cosTable.resize(qMax(n - 1, 0));
+    sinTable.resize(qMax(n - 1, 0));
+    for (int size = 2; size <= n; size *= 2)
+    {
+        int half = size/2;
+        for (int k = 0; k < half; k ++)
+        {
+            cosTable[half - 1 + k] = qCos(2.*M_PI*k/size);
+            sinTable[half - 1 + k] = -qSin(2.*M_PI*k/size);
+        }
+    }
+
+    window.resize(n);
+    windowPower = 0.;
+    for (int i = 0; i < n; i ++)
+    {
+        window[i] = 0.5 - 0.5*qCos(2.*M_PI*i/n);   // periodic Hann
+        windowPower += window[i]*window[i];
+    }
+}
+
+// The butterflies of one group of a stage. The halves don't overlap, and the
+// twiddle factors are read with unit stride, so GCC vectorises this at -O3.
+static void butterflies(qreal * __restrict re0, qreal * __restrict im0, qreal * __restrict re1, qreal * __restrict im1,
+                        const qreal * __restrict cs, const qreal * __restrict sn, int half)
+{
+    for (int k = 0; k < half; k ++)
+    {
+        qreal c = cs[k], s = sn[k];
+        qreal tr = re1[k]*c - im1[k]*s;
+        qreal ti = re1[k]*s + im1[k]*c;
+        re1[k] = re0[k] - tr;
+        im1[k] = im0[k] - ti;
+        re0[k] += tr;
+        im0[k] += ti;
+    }
+}
+
+void t_FftPlan::transform(qreal *re, qreal *im) const
+{
+    for (int i = 0; i < n; i ++)
+    {
+        int j = bitrev.at(i);
+        if (j > i)
+        {
+            qSwap(re[i], re[j]);
+            qSwap(im[i], im[j]);
+        }
+    }
+
+    for (int size = 2; size <= n; size *= 2)
+    {
+        int half = size/2;
+        const qreal *cs = cosTable.constData() + half - 1;
+        const qreal *sn = sinTable.constData() + half - 1;
+        for (int start = 0; start < n; start += size)
+        {
+            butterflies(re + start, im + start, re + start + half, im + start + half, cs, sn, half);
+        }
+    }
+}
+
+const t_FftPlan &fftPlan(int length)
+{
+    static QMutex mutex;
+    static QMap<int, t_FftPlan *> plans;
+
+    QMutexLocker locker(&mutex);
+    if (!plans.contains(length))
+    {
+        plans.insert(length, new t_FftPlan(length));
+    }
+    return *plans.value(length);
+}
+
+// Welch segment length: a power of two, up to 256 samples (about 2 s at 125 Hz).
+// Traces shorter than 16 samples are zero-padded.
+static int segmentLength(int samples)
+{
+    int n = 16;
+    while (n*2 <= samples && n < 256)
+    {
+        n *= 2;
+    }
+    return n;
+}
+
+// One-sided power spectral density of one axis, in g^2/Hz, by Welch's method:
+// Hann-windowed segments overlapping by half, each with its mean removed.
+QVector<qreal> welchPsd(const t_Trace &trace, int axis, qreal &df)
+{
+    const std::vector<float> vals = axisSamples(trace, axis);
+    int len = static_cast<int>(vals.size());
+    int n = segmentLength(len);
+    const t_FftPlan &plan = fftPlan(n);
+    qreal fs = static_cast<qreal>(trace.frequency);
+
+    QVector<qreal> psd(n/2 + 1, 0.);
+    QVector<qreal> re(n), im(n);
+    int segments = 0;
+
+    for (int start = 0; start == 0 || start + n <= len; start += n/2)
+    {
+        int m = qMin(n, len - start);
+        qreal mean = 0.;
+        for (int i = 0; i < m; i ++)
+        {
+            mean += static_cast<qreal>(vals[start + i]);
+        }
+        mean /= qMax(m, 1);
+
+        for (int i = 0; i < n; i ++)
+        {
+            re[i] = (i < m) ? (static_cast<qreal>(vals[start + i]) - mean)*plan.window.at(i) : 0.;
+            im[i] = 0.;
+        }
+        plan.transform(re.data(), im.data());
+
+        for (int k = 0; k <= n/2; k ++)
+        {
+            qreal p = re.at(k)*re.at(k) + im.at(k)*im.at(k);
+            psd[k] += (k > 0 && k < n/2) ? 2.*p : p;    // fold in the negative frequencies
+        }
+        segments ++;
+    }
+
+    qreal scale = 1./(static_cast<qreal>(segments)*fs*plan.windowPower);
+    for (int k = 0; k <= n/2; k ++)
+    {
+        psd[k] *= scale;
+    }
+    df = fs/n;
+    return psd;
+}
+
+// Dominant frequency and band energies of one trace, from the sum of the three axis PSDs
+void addSpectrum(t_Trace &trace)
+{
+    trace.dominantFrequency = 0.0f;
+    for (int b = 0; b < NumBands; b ++)
+    {
+        trace.bandRms[b] = 0.0f;
+    }
+    if (sampleCount(trace) == 0)
+        return;
+
+    qreal df = 0.;
+    QVector<qreal> total = welchPsd(trace, 0, df);
+    for (int axis = 1; axis < 3; axis ++)
+    {
+        QVector<qreal> psd = welchPsd(trace, axis, df);
+        for (int k = 0; k < total.size(); k ++)
+        {
+            total[k] += psd.at(k);
+        }
+    }
+
+    qreal peak = 0.;
+    qreal energy[NumBands] = {0., 0., 0.};
+    for (int k = 1; k < total.size(); k ++)     // DC has been removed
+    {
+        qreal f = k*df;
+        if (total.at(k) > peak)
+        {
+            peak = total.at(k);
+            trace.dominantFrequency = static_cast<float>(f);
+        }
+        for (int b = NumBands - 1; b >= 0; b --)
+        {
+            if (f >= BandEdges[b])
+            {
+                energy[b] += total.at(k)*df;
+                break;
+            }
+        }
+    }
+    for (int b = 0; b < NumBands; b ++)
+    {
+        trace.bandRms[b] = 16384.0f*static_cast<float>(qSqrt(energy[b]));  // same units as max/rms
+    }
+}
+
+// Calculate the spectral summaries of the traces from index "first" onwards, spread over the thread pool.
+void addSpectra(int first)
+{
+    QVector<int> indexes;
+    for (int i = first; getTrace(i) != nullptr; i ++)
+    {
+        indexes.push_back(i);
+    }
+    QtConcurrent::blockingMap(indexes, [](int &i) { addSpectrum(*getTrace(i)); });
+}
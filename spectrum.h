@@ -0,0 +1,35 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <QVector>
+
+#include "loadtrace.h"
+
+// Frequency bands whose energy is summarised for each trace, in Hz. The last
+// band runs up to half the sample rate.
+const int NumBands = 3;
+const qreal BandEdges[NumBands] = {1.0, 8.0, 20.0};
+
+// Radix-2 FFT of one length, with its tables. Plans are made once per length
+// and shared, see fftPlan().
+class t_FftPlan
+{
+public:
+    explicit t_FftPlan(int length);
+    void transform(qreal *re, qreal *im) const;   // in place
+
+    int n;
+    QVector<int>   bitrev;
+    QVector<qreal> cosTable;    // twiddle factors of each stage in turn, contiguous:
+    QVector<qreal> sinTable;    // the stage of size 2*half starts at half - 1
+    QVector<qreal> window;      // Hann window for Welch segments of length n
+    qreal          windowPower; // sum of the squares of the window
+};
+
+extern const t_FftPlan &fftPlan(int length);
+
+extern QVector<qreal> welchPsd(const t_Trace &trace, int axis, qreal &df);
+extern void addSpectrum(t_Trace &trace);
+extern void addSpectra(int first);
+
+#endif // SPECTRUM_H
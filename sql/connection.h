@@ -5,17 +5,31 @@
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QSqlRecord>
 #include <QDir>
 
 /*
     This file defines a helper function to open a connection to an
     in-memory SQLITE database and to create a test table.
 */
-static bool createConnection(QDir dir)
+
+// Whether a failure is shown in a message box, or only logged. Batch runs turn
+// it off, as there may be no one to click it away.
+inline bool &connectionMessageBoxes(void)
+{
+    static bool on = true;
+    return on;
+}
+
+inline bool createConnection(QDir dir)
 {
     QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
     db.setDatabaseName(dir.filePath("Exclude.sqlite"));
     if (!db.open()) {
+        if (!connectionMessageBoxes()) {
+            qWarning("Cannot open %s: %s", qPrintable(db.databaseName()), qPrintable(db.lastError().text()));
+            return false;
+        }
         QMessageBox::critical(nullptr, QObject::tr("Cannot open database"),
             QObject::tr("Unable to establish a database connection.\n"
                         "This example needs SQLite support. Please read "
@@ -29,7 +43,14 @@ static bool createConnection(QDir dir)
     query.exec("create table if not exists trace (id integer primary key, "
                                                 "filename text,"
                                                 "datetime bigint,"
-                                                "exclusion int)");
+                                                "exclusion int,"
+                                                "rule text)");
+
+    // Databases made before exclusion rules don't record which rule excluded a trace
+    if (!db.record("trace").contains("rule"))
+    {
+        query.exec("alter table trace add column rule text");
+    }
     return true;
 }
 
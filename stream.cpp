@@ -0,0 +1,153 @@
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <QVector>
+
+#include "loadtrace.h"
+#include "exceedance.h"
+#include "spectrum.h"
+#include "results.h"
+#include "distributions.h"
+#include "stream.h"
+
+/*
+    Each trace is finished with as soon as it's parsed: its spectrum, windowed
+    peak, VDV contribution and exceedances are taken, then its samples are
+    dropped. Rows are held back only until their event has ended (the next trace
+    is 6 s or more later), as the windowed max is shown on an event's first
+    trace. The tables that follow the trace table in the output are collected
+    in temporary files meanwhile.
+*/
+
+class t_StreamWriter : public t_Sink
+{
+public:
+    t_StreamWriter(QTextStream &out, bool saveWithWindowedMax);
+    bool isOpen(void) const { return extrasFile.isOpen() && exceedancesFile.isOpen(); }
+    void trace(t_Trace &trace) override;
+    void extra(const t_Extra &extra) override;
+    void finish(void);
+
+private:
+    void endEvent(void);
+    void append(QTemporaryFile &file, QTextStream &stream);
+
+    QTextStream &out;
+    bool saveWithWindowedMax;
+
+    QVector<t_Trace> event;     // traces of the event so far, without samples
+    qreal eventPeak;
+    bool  eventExcluded;
+
+    QTemporaryFile extrasFile;
+    QTextStream    extras;
+    QTemporaryFile exceedancesFile;
+    QTextStream    exceedances;
+
+    t_Distributions distributions;
+};
+
+t_StreamWriter::t_StreamWriter(QTextStream &out, bool saveWithWindowedMax)
+    : out(out), saveWithWindowedMax(saveWithWindowedMax), eventPeak(0.), eventExcluded(false)
+{
+    if (extrasFile.open())
+    {
+        extras.setDevice(&extrasFile);
+    }
+    if (exceedancesFile.open())
+    {
+        exceedances.setDevice(&exceedancesFile);
+    }
+}
+
+void t_StreamWriter::trace(t_Trace &trace)
+{
+    if (!event.isEmpty() && !(trace.dt < event.last().dt.addSecs(6)))
+    {
+        endEvent();
+    }
+
+    addSpectrum(trace);
+    addTraceToVdv(trace);
+    distributions.addTrace(trace);
+    if (saveWithWindowedMax)
+    {
+        // As windowedMaxOfEvent(): nothing after an excluded trace counts
+        if (trace.exclusion > 0)
+        {
+            eventExcluded = true;
+        }
+        if (!eventExcluded)
+        {
+            eventPeak = qMax(eventPeak, traceWindowedPeak(trace));
+        }
+    }
+
+    t_ExceedanceScanner &scanner = getExceedanceScanner();
+    foreach (const t_Exceedance &e, scanner.exceedances())
+    {
+        writeExceedanceRow(exceedances, e, trace);
+    }
+    scanner.clear();
+
+    std::vector<std::array<float,3>>().swap(trace.vals);
+    trace.packed = t_PackedSamples();
+    event.push_back(trace);
+}
+
+void t_StreamWriter::extra(const t_Extra &extra)
+{
+    writeExtraRow(extras, extra);
+}
+
+void t_StreamWriter::endEvent(void)
+{
+    if (event.isEmpty())
+        return;
+
+    if (saveWithWindowedMax && !eventExcluded)
+    {
+        event[0].wMax = windowedMaxFromPeak(eventPeak);
+    }
+    distributions.addEvent(event.at(0));
+    foreach (const t_Trace &t, event)
+    {
+        writeTraceRow(out, t, saveWithWindowedMax);
+    }
+    event.clear();
+    eventPeak = 0.;
+    eventExcluded = false;
+}
+
+void t_StreamWriter::append(QTemporaryFile &file, QTextStream &stream)
+{
+    stream.flush();
+    stream.seek(0);
+    while (!stream.atEnd())
+    {
+        out << stream.read(65536);
+    }
+    file.close();
+}
+
+void t_StreamWriter::finish(void)
+{
+    endEvent();
+    writeVdvTable(out, currentVdv());
+    writeExtraHeader(out);
+    append(extrasFile, extras);
+    writeExceedanceHeader(out);
+    append(exceedancesFile, exceedances);
+    writeDistributions(out, distributions);
+}
+
+bool streamResults(QDir dir, QTextStream &out, bool saveWithWindowedMax)
+{
+    t_StreamWriter writer(out, saveWithWindowedMax);
+    if (!writer.isOpen())
+        return false;
+
+    writeTraceHeader(out, saveWithWindowedMax);
+    loadtraceStreaming(dir, writer);
+    writer.finish();
+    return true;
+}
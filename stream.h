@@ -0,0 +1,11 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <QDir>
+#include <QTextStream>
+
+// Produce the same output as loading, processing and writeResults(), in one
+// pass over the files with memory that doesn't grow with the number of traces.
+extern bool streamResults(QDir dir, QTextStream &out, bool saveWithWindowedMax);
+
+#endif // STREAM_H
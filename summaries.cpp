@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <QtMath>
+
+#include "summaries.h"
+
+const char * const SummaryColumnNames[NumSummaryColumns] = {"Max", "RMS", "wMax", "4thPower", "maxAxis"};
+
+static t_Summaries Summaries;
+static bool SummariesValid = false;
+
+int summaryColumnFromName(QString name)
+{
+    for (int c = 0; c < NumSummaryColumns; c ++)
+    {
+        if (name.compare(SummaryColumnNames[c], Qt::CaseInsensitive) == 0)
+        {
+            return c;
+        }
+    }
+    return -1;
+}
+
+// Called whenever a trace, or a value calculated from one, changes.
+void invalidateSummaries(void)
+{
+    SummariesValid = false;
+}
+
+// Called when the exclusion or wMax of one trace changes without any trace being added
+// or removed. Refreshes just that trace's row, if the summaries are already built.
+void updateSummary(int index)
+{
+    if (!SummariesValid || index < 0 || index >= Summaries.size())
+        return;
+
+    const t_Trace *p_t = getTrace(index);
+    Summaries.exclusion[index] = p_t->exclusion;
+    Summaries.cols[ColWMax][index] = p_t->wMax;
+}
+
+const t_Summaries &getSummaries(void)
+{
+    if (!SummariesValid)
+    {
+        Summaries.time.clear();
+        Summaries.exclusion.clear();
+        for (int c = 0; c < NumSummaryColumns; c ++)
+        {
+            Summaries.cols[c].clear();
+        }
+        Summaries.inTimeOrder = true;
+
+        int i = 0;
+        t_Trace * p_t;
+        while ((p_t = getTrace(i)) != nullptr)
+        {
+            qint64 t = p_t->dt.toMSecsSinceEpoch();
+            if (i > 0 && t < Summaries.time.last())
+            {
+                Summaries.inTimeOrder = false;
+            }
+            Summaries.time.push_back(t);
+            Summaries.exclusion.push_back(p_t->exclusion);
+            Summaries.cols[ColMax].push_back(p_t->maximumDeviation);
+            Summaries.cols[ColRms].push_back(p_t->rmsDeviation);
+            Summaries.cols[ColWMax].push_back(p_t->wMax);
+            Summaries.cols[Col4thPower].push_back(p_t->total4thPowerDeviation);
+            Summaries.cols[ColMaxAxis].push_back(static_cast<float>(p_t->maxAxis));
+            i ++;
+        }
+        SummariesValid = true;
+    }
+    return Summaries;
+}
+
+// Range of trace indexes [first, last) that can be within the filter's times. When the
+// traces are in time order that is found by binary search, otherwise it's everything.
+static void timeRange(const t_Summaries &s, const QDateTime &from, const QDateTime &to, int &first, int &last)
+{
+    first = 0;
+    last = s.size();
+    if (!s.inTimeOrder)
+        return;
+    if (from.isValid())
+    {
+        first = static_cast<int>(std::lower_bound(s.time.begin(), s.time.end(), from.toMSecsSinceEpoch()) - s.time.begin());
+    }
+    if (to.isValid())
+    {
+        last = static_cast<int>(std::upper_bound(s.time.begin(), s.time.end(), to.toMSecsSinceEpoch()) - s.time.begin());
+    }
+}
+
+static inline bool selected(const t_Summaries &s, int i, const QDateTime &from, const QDateTime &to, bool includeExcluded)
+{
+    if (!includeExcluded && s.exclusion.at(i) > 0)
+        return false;
+    if (!s.inTimeOrder)
+    {
+        if (from.isValid() && s.time.at(i) < from.toMSecsSinceEpoch())
+            return false;
+        if (to.isValid() && s.time.at(i) > to.toMSecsSinceEpoch())
+            return false;
+    }
+    return true;
+}
+
+// The k largest values in [first, last), largest first, using a heap of size k.
+static t_RankedList topKInRange(const t_Summaries &s, t_SummaryColumn col, int k, int first, int last, const QDateTime &from, const QDateTime &to, bool includeExcluded)
+{
+    typedef std::pair<float, int> t_Entry;
+    std::priority_queue<t_Entry, std::vector<t_Entry>, std::greater<t_Entry> > heap;   // smallest on top
+    const QVector<float> &v = s.cols[col];
+    int n = 0;
+
+    for (int i = first; i < last; i ++)
+    {
+        if (!selected(s, i, from, to, includeExcluded))
+            continue;
+        n ++;
+        if (static_cast<int>(heap.size()) < k)
+        {
+            heap.push(t_Entry(v.at(i), i));
+        }
+        else if (k > 0 && v.at(i) > heap.top().first)
+        {
+            heap.pop();
+            heap.push(t_Entry(v.at(i), i));
+        }
+    }
+
+    t_RankedList res;
+    res.resize(static_cast<int>(heap.size()));
+    for (int j = res.size() - 1; j >= 0; j --)
+    {
+        res[j].trace = heap.top().second;
+        res[j].value = heap.top().first;
+        res[j].percentRank = 100.*static_cast<qreal>(n - j - 1)/static_cast<qreal>(n);
+        heap.pop();
+    }
+    return res;
+}
+
+t_RankedList topK(t_SummaryColumn col, int k, const t_TraceFilter &filter)
+{
+    const t_Summaries &s = getSummaries();
+    int first, last;
+    timeRange(s, filter.from, filter.to, first, last);
+    return topKInRange(s, col, k, first, last, filter.from, filter.to, filter.includeExcluded);
+}
+
+// Value below which "percent" of the selected traces lie. Uses a selection, not a sort.
+float percentileOf(t_SummaryColumn col, qreal percent, const t_TraceFilter &filter)
+{
+    const t_Summaries &s = getSummaries();
+    int first, last;
+    timeRange(s, filter.from, filter.to, first, last);
+
+    std::vector<float> vals;
+    vals.reserve(static_cast<size_t>(last - first));
+    for (int i = first; i < last; i ++)
+    {
+        if (selected(s, i, filter.from, filter.to, filter.includeExcluded))
+        {
+            vals.push_back(s.cols[col].at(i));
+        }
+    }
+    if (vals.empty())
+        return 0.0f;
+
+    size_t nth = static_cast<size_t>(qFloor(qBound(0., percent, 100.)/100.*static_cast<qreal>(vals.size() - 1)));
+    std::nth_element(vals.begin(), vals.begin() + static_cast<long>(nth), vals.end());
+    return vals[nth];
+}
+
+static int countSelected(const t_Summaries &s, int first, int last, const QDateTime &from, const QDateTime &to, bool includeExcluded)
+{
+    int n = 0;
+    for (int i = first; i < last; i ++)
+    {
+        if (selected(s, i, from, to, includeExcluded))
+            n ++;
+    }
+    return n;
+}
+
+// The top "percent" of the selected traces, largest first.
+t_RankedList topPercent(t_SummaryColumn col, qreal percent, const t_TraceFilter &filter)
+{
+    const t_Summaries &s = getSummaries();
+    int first, last;
+    timeRange(s, filter.from, filter.to, first, last);
+
+    int k = qCeil(static_cast<qreal>(countSelected(s, first, last, filter.from, filter.to, filter.includeExcluded))*percent/100.);
+    return topKInRange(s, col, k, first, last, filter.from, filter.to, filter.includeExcluded);
+}
+
+// The top "percent" of traces within each period (e.g. each night), in period order.
+t_RankedList topPercentPerPeriod(t_SummaryColumn col, qreal percent, const t_TraceFilter &filter, const t_VDVs &periods)
+{
+    const t_Summaries &s = getSummaries();
+    t_RankedList res;
+
+    foreach (const t_VDV &p, periods)
+    {
+        QDateTime from = p.start;
+        QDateTime to = p.end;
+        if (filter.from.isValid() && filter.from > from)
+            from = filter.from;
+        if (filter.to.isValid() && filter.to < to)
+            to = filter.to;
+        if (to < from)
+            continue;
+
+        int first, last;
+        timeRange(s, from, to, first, last);
+
+        // Count first, so that k is known before the heap pass
+        int k = qCeil(static_cast<qreal>(countSelected(s, first, last, from, to, filter.includeExcluded))*percent/100.);
+        res += topKInRange(s, col, k, first, last, from, to, filter.includeExcluded);
+    }
+    return res;
+}
@@ -0,0 +1,63 @@
+#ifndef SUMMARIES_H
+#define SUMMARIES_H
+
+#include <QDateTime>
+#include <QVector>
+#include <QString>
+
+#include "loadtrace.h"
+
+// Per-trace summary values that can be queried
+typedef enum
+{
+    ColMax = 0,         // maximumDeviation
+    ColRms = 1,         // rmsDeviation
+    ColWMax = 2,        // wMax
+    Col4thPower = 3,    // total4thPowerDeviation
+    ColMaxAxis = 4,     // maxAxis
+    NumSummaryColumns = 5
+} t_SummaryColumn;
+
+extern const char * const SummaryColumnNames[NumSummaryColumns];
+extern int summaryColumnFromName(QString name);   // -1 if unknown
+
+// The summary values of every trace, one array per value, in trace order
+class t_Summaries
+{
+public:
+    int size(void) const { return time.size(); }
+
+    QVector<qint64> time;       // ms since epoch, UTC
+    QVector<uint>   exclusion;
+    QVector<float>  cols[NumSummaryColumns];
+    bool            inTimeOrder;
+};
+
+extern const t_Summaries &getSummaries(void);
+extern void invalidateSummaries(void);
+extern void updateSummary(int index);
+
+class t_TraceFilter
+{
+public:
+    QDateTime from;                 // invalid for no limit
+    QDateTime to;                   // invalid for no limit
+    bool includeExcluded = false;
+};
+
+class t_Ranked
+{
+public:
+    int    trace;
+    float  value;
+    qreal  percentRank;     // percentage of the selected traces with a lower value
+};
+
+typedef QVector<t_Ranked> t_RankedList;
+
+extern t_RankedList topK(t_SummaryColumn col, int k, const t_TraceFilter &filter);
+extern t_RankedList topPercent(t_SummaryColumn col, qreal percent, const t_TraceFilter &filter);
+extern float percentileOf(t_SummaryColumn col, qreal percent, const t_TraceFilter &filter);
+extern t_RankedList topPercentPerPeriod(t_SummaryColumn col, qreal percent, const t_TraceFilter &filter, const t_VDVs &periods);
+
+#endif // SUMMARIES_H
@@ -5,33 +5,102 @@
 #include <QtCharts/QChartView>
 #include <QtCharts/QLineSeries>
 #include <QtCharts/QVXYModelMapper>
+#include <QtCharts/QAreaSeries>
+#include <QtCharts/QDateTimeAxis>
+#include <QtCharts/QValueAxis>
+#include <QtCharts/QLogValueAxis>
+#include <QtCharts/QScatterSeries>
 #include <QtWidgets/QHeaderView>
+#include <QWheelEvent>
+#include <QMouseEvent>
 
 #include "loadtrace.h"
+#include "telemetry.h"
+#include "spectrum.h"
+#include "timeline.h"
 
 QT_CHARTS_USE_NAMESPACE
 
-static void setTraceSeries(t_Trace t1, QLineSeries *l1, unsigned int n)
+// Points to plot for one axis of a trace, with time starting at "t0" seconds.
+// Traces longer than "maxPoints" are decimated by keeping the minimum and the
+// maximum of each bucket of samples, so peaks are never lost.
+QVector<QPointF> traceSeries(const t_Trace &t1, unsigned int n, qreal t0, int maxPoints)
 {
-    size_t i;
+    QVector<QPointF> points;
+    const std::vector<float> vals = axisSamples(t1, static_cast<int>(n));
+    int count = static_cast<int>(vals.size());
+    qreal dt = 1./static_cast<qreal>(t1.frequency);
 
-    for (i = 0; i < t1.vals.size(); i ++)
+    if (maxPoints <= 0 || count <= maxPoints)
     {
-        l1->append((static_cast<double>(i))/t1.frequency, static_cast<double>(t1.vals[i][n]));
+        points.reserve(count);
+        for (int i = 0; i < count; i ++)
+        {
+            points.append(QPointF(t0 + i*dt, static_cast<qreal>(vals[static_cast<size_t>(i)])));
+        }
+        return points;
     }
 
+    int buckets = maxPoints/2;
+    points.reserve(2*buckets);
+    for (int b = 0; b < buckets; b ++)
+    {
+        int first = static_cast<int>(static_cast<qint64>(b)*count/buckets);
+        int last = static_cast<int>(static_cast<qint64>(b + 1)*count/buckets);
+        int iMin = first, iMax = first;
+        for (int i = first + 1; i < last; i ++)
+        {
+            if (vals[static_cast<size_t>(i)] < vals[static_cast<size_t>(iMin)])
+                iMin = i;
+            if (vals[static_cast<size_t>(i)] > vals[static_cast<size_t>(iMax)])
+                iMax = i;
+        }
+        // In time order, so the line goes through both
+        int i1 = qMin(iMin, iMax), i2 = qMax(iMin, iMax);
+        points.append(QPointF(t0 + i1*dt, static_cast<qreal>(vals[static_cast<size_t>(i1)])));
+        if (i2 != i1)
+        {
+            points.append(QPointF(t0 + i2*dt, static_cast<qreal>(vals[static_cast<size_t>(i2)])));
+        }
+    }
+    return points;
+}
+
+static void setTraceSeries(const t_Trace &t1, QLineSeries *l1, unsigned int n)
+{
+    l1->replace(traceSeries(t1, n, 0., 4000));
 }
 
 void TableWidget::ShowTrace(QTreeWidgetItem *newItem)
 {
-    t_Trace *p_t = getTrace(newItem->data(0, Qt::UserRole+1).toInt());
+    if (newItem == nullptr)
+        return;
+
+    currentIndex = newItem->data(0, Qt::UserRole+1).toInt();
+    ShowIndex(currentIndex);
+}
+
+void TableWidget::ShowIndex(int index)
+{
+    t_Trace *p_t = getTrace(index);
 
     QChart * const theChart = chart();
 
-    if (theChart == nullptr)
+    if (theChart == nullptr || p_t == nullptr)
         return;
 
+    if (spectrumMode)
+    {
+        ShowSpectrum(p_t);
+        return;
+    }
+
     theChart->removeAllSeries();
+    foreach (QAbstractAxis *axis, theChart->axes())
+    {
+        theChart->removeAxis(axis);
+        delete axis;
+    }
 
     QLineSeries *series = new QLineSeries;
     series->setName("X");
@@ -50,3 +119,463 @@ void TableWidget::ShowTrace(QTreeWidgetItem *newItem)
 
     theChart->createDefaultAxes();
 }
+
+void TableWidget::setSpectrumMode(bool on)
+{
+    spectrumMode = on;
+    if (currentIndex >= 0)
+    {
+        ShowIndex(currentIndex);
+    }
+}
+
+// Welch power spectral density of each axis, on a logarithmic scale
+void TableWidget::ShowSpectrum(t_Trace *p_t)
+{
+    QChart * const theChart = chart();
+
+    theChart->removeAllSeries();
+    foreach (QAbstractAxis *axis, theChart->axes())
+    {
+        theChart->removeAxis(axis);
+        delete axis;
+    }
+
+    QValueAxis *xAxis = new QValueAxis;
+    xAxis->setTitleText("Frequency [Hz]");
+    xAxis->setRange(0., static_cast<qreal>(p_t->frequency)/2.);
+    theChart->addAxis(xAxis, Qt::AlignBottom);
+
+    QLogValueAxis *yAxis = new QLogValueAxis;
+    yAxis->setTitleText("PSD [g^2/Hz]");
+    yAxis->setLabelFormat("%.0e");
+    theChart->addAxis(yAxis, Qt::AlignLeft);
+
+    const char * const names[3] = {"X", "Y", "Z"};
+    qreal lo = 1.e99, hi = 0.;
+    for (int axis = 0; axis < 3; axis ++)
+    {
+        qreal df = 0.;
+        QVector<qreal> psd = welchPsd(*p_t, axis, df);
+
+        QLineSeries *series = new QLineSeries;
+        series->setName(names[axis]);
+        for (int k = 1; k < psd.size(); k ++)   // no DC: the mean has been removed
+        {
+            qreal p = qMax(psd.at(k), 1.e-15);  // log axis
+            series->append(k*df, p);
+            lo = qMin(lo, p);
+            hi = qMax(hi, p);
+        }
+        theChart->addSeries(series);
+        series->attachAxis(xAxis);
+        series->attachAxis(yAxis);
+    }
+    if (lo <= hi)
+    {
+        yAxis->setRange(lo, hi);
+    }
+}
+
+
+// Add the mean of a channel as a line, and optionally its min/max as a band behind it.
+// The range lo..hi is widened to include it.
+static void addRollupSeries(QChart *theChart, const t_Rollups &rs, int ch, QString name, bool withBand, QAbstractAxis *xAxis, QAbstractAxis *yAxis, qreal &lo, qreal &hi)
+{
+    QLineSeries *mean = new QLineSeries;
+    QLineSeries *lower = new QLineSeries;
+    QLineSeries *upper = new QLineSeries;
+
+    for (int end = rs.size(), i = 0; i < end; i ++)
+    {
+        if (rs.at(i).count[ch] > 0)
+        {
+            qreal t = static_cast<qreal>(rs.at(i).start);
+            mean->append(t, static_cast<qreal>(rs.at(i).mean(ch)));
+            lower->append(t, static_cast<qreal>(rs.at(i).min[ch]));
+            upper->append(t, static_cast<qreal>(rs.at(i).max[ch]));
+            lo = qMin(lo, static_cast<qreal>(rs.at(i).min[ch]));
+            hi = qMax(hi, static_cast<qreal>(rs.at(i).max[ch]));
+        }
+    }
+
+    if (mean->count() == 0)
+    {
+        delete mean;
+        delete lower;
+        delete upper;
+        return;
+    }
+
+    if (withBand)
+    {
+        QAreaSeries *band = new QAreaSeries(upper, lower);
+        band->setName(name + " min/max");
+        band->setOpacity(0.3);
+        theChart->addSeries(band);
+        band->attachAxis(xAxis);
+        band->attachAxis(yAxis);
+    }
+    else
+    {
+        delete lower;
+        delete upper;
+    }
+
+    mean->setName(name);
+    theChart->addSeries(mean);
+    mean->attachAxis(xAxis);
+    mean->attachAxis(yAxis);
+}
+
+void TelemetryWidget::ShowTelemetry(void)
+{
+    QChart * const theChart = chart();
+
+    if (theChart == nullptr)
+        return;
+
+    theChart->removeAllSeries();
+    foreach (QAbstractAxis *axis, theChart->axes())
+    {
+        theChart->removeAxis(axis);
+        delete axis;
+    }
+
+    const t_Telemetry &tel = getTelemetry();
+
+    // Hourly points for up to a fortnight, daily beyond that. Either way only the
+    // rollups are plotted, never the individual records.
+    t_Rollups rs = tel.rollups(Hourly);
+    if (!rs.isEmpty() && rs.last().start - rs.first().start > 14LL*24*3600*1000)
+    {
+        rs = tel.rollups(Daily);
+    }
+
+    QDateTimeAxis *xAxis = new QDateTimeAxis;
+    xAxis->setFormat("dd/MM HH:mm");
+    xAxis->setTitleText("Date/time (UTC)");
+    theChart->addAxis(xAxis, Qt::AlignBottom);
+
+    QValueAxis *vAxis = new QValueAxis;
+    vAxis->setTitleText("V_bat [V]");
+    theChart->addAxis(vAxis, Qt::AlignLeft);
+
+    QValueAxis *tAxis = new QValueAxis;
+    tAxis->setTitleText("Temperature [degC]");
+    theChart->addAxis(tAxis, Qt::AlignRight);
+
+    // Ranges start empty and are widened by each series
+    qreal vLo = 1.e9, vHi = -1.e9, tLo = 1.e9, tHi = -1.e9;
+    addRollupSeries(theChart, rs, VBat, "V_bat", true, xAxis, vAxis, vLo, vHi);
+    addRollupSeries(theChart, rs, Temp1, "Temp 1", false, xAxis, tAxis, tLo, tHi);
+    addRollupSeries(theChart, rs, Temp2, "Temp 2", false, xAxis, tAxis, tLo, tHi);
+    addRollupSeries(theChart, rs, Temp3, "Temp 3", false, xAxis, tAxis, tLo, tHi);
+    if (vLo <= vHi)
+    {
+        vAxis->setRange(vLo, vHi);
+    }
+    if (tLo <= tHi)
+    {
+        tAxis->setRange(tLo, tHi);
+    }
+
+    if (!rs.isEmpty())
+    {
+        xAxis->setRange(QDateTime::fromMSecsSinceEpoch(rs.first().start, Qt::UTC),
+                        QDateTime::fromMSecsSinceEpoch(rs.last().start, Qt::UTC));
+    }
+
+    show();
+    raise();
+}
+
+// Spans no longer than this show the samples themselves
+static const qint64 TimelineSampleSpan = 30000;   // ms
+
+TimelineWidget::TimelineWidget(QWidget *parent) : QChartView(parent)
+{
+    // The fine level is drawn once panning or zooming pauses
+    fineTimer = new QTimer(this);
+    fineTimer->setSingleShot(true);
+    fineTimer->setInterval(80);
+    connect(fineTimer, &QTimer::timeout, this, [this]() { render(false); });
+}
+
+void TimelineWidget::ShowTimeline(void)
+{
+    const t_TimelinePyramid &tl = getTimeline();
+
+    setView(tl.first, tl.last);
+    show();
+    raise();
+}
+
+void TimelineWidget::setView(qint64 from, qint64 to)
+{
+    const t_TimelinePyramid &tl = getTimeline();
+
+    // Keep within the campaign, and no narrower than a second
+    if (to - from < 1000)
+    {
+        qint64 mid = (from + to)/2;
+        from = mid - 500;
+        to = mid + 500;
+    }
+    if (to - from > tl.last - tl.first)
+    {
+        from = tl.first;
+        to = qMax(tl.last, tl.first + 1000);
+    }
+    else if (from < tl.first)
+    {
+        to += tl.first - from;
+        from = tl.first;
+    }
+    else if (to > tl.last)
+    {
+        from -= to - tl.last;
+        to = tl.last;
+    }
+    viewFrom = from;
+    viewTo = to;
+
+    render(true);
+    fineTimer->start();
+}
+
+// Time under a position in the view, from the plot area of the chart
+qint64 TimelineWidget::timeAt(const QPoint &pos) const
+{
+    QRectF area = chart()->plotArea();
+    if (area.width() <= 0.)
+        return viewFrom;
+    qreal f = (mapToScene(pos).x() - area.left())/area.width();
+    return viewFrom + qRound64(qBound(0., f, 1.)*static_cast<qreal>(viewTo - viewFrom));
+}
+
+// Plot the current view. A coarse render uses a level a few steps above the one
+// that matches the width in pixels, so it stays quick while dragging.
+void TimelineWidget::render(bool coarse)
+{
+    QChart * const theChart = chart();
+
+    if (theChart == nullptr)
+        return;
+
+    theChart->removeAllSeries();
+    foreach (QAbstractAxis *axis, theChart->axes())
+    {
+        theChart->removeAxis(axis);
+        delete axis;
+    }
+
+    const t_TimelinePyramid &tl = getTimeline();
+    if (tl.levels() == 0)
+        return;
+
+    QDateTimeAxis *xAxis = new QDateTimeAxis;
+    xAxis->setFormat(viewTo - viewFrom > 2*24*3600*1000LL ? "dd/MM" : "dd/MM HH:mm:ss");
+    xAxis->setTitleText("Date/time (UTC)");
+    theChart->addAxis(xAxis, Qt::AlignBottom);
+
+    QValueAxis *yAxis = new QValueAxis;
+    yAxis->setTitleText("Deviation");
+    theChart->addAxis(yAxis, Qt::AlignLeft);
+
+    qreal yHi = 0.;
+    if (!coarse && viewTo - viewFrom <= TimelineSampleSpan)
+    {
+        // The samples of every trace in view
+        QLineSeries *samples = new QLineSeries;
+        samples->setName("Deviation");
+        for (int n = traceCount(), i = 0; i < n; i ++)
+        {
+            const t_Trace * p_t = getTrace(i);
+            const qint64 t0 = p_t->dt.toMSecsSinceEpoch();
+            const qreal msPerSample = 1000./static_cast<qreal>(p_t->frequency);
+            if (t0 > viewTo || t0 + qRound64(sampleCount(*p_t)*msPerSample) < viewFrom)
+                continue;
+            QVector<qreal> env = ValsToRms(*p_t);
+            if (samples->count() > 0)
+            {
+                // Break the line between traces
+                samples->append(static_cast<qreal>(t0) - 1., 0.);
+            }
+            for (int k = 0; k < env.size(); k ++)
+            {
+                qreal e = 16384.*env.at(k);
+                samples->append(static_cast<qreal>(t0) + k*msPerSample, e);
+                yHi = qMax(yHi, e);
+            }
+        }
+        theChart->addSeries(samples);
+        samples->attachAxis(xAxis);
+        samples->attachAxis(yAxis);
+    }
+    else
+    {
+        const int pixels = qMax(100, qRound(theChart->plotArea().width()));
+        int level = tl.levelFor(viewTo - viewFrom, pixels);
+        if (coarse)
+        {
+            level = qMin(level + 3, tl.levels() - 1);
+        }
+        const qint64 w = tl.width(level);
+        const t_TimelineLevel bins = tl.query(level, viewFrom, viewTo);
+
+        // Envelope of the samples, down to zero wherever there are none
+        QLineSeries *upper = new QLineSeries;
+        QLineSeries *lower = new QLineSeries;
+        QScatterSeries *peaks = new QScatterSeries;
+        QScatterSeries *rmss = new QScatterSeries;
+        QScatterSeries *wMaxs = new QScatterSeries;
+        peaks->setName("Max");
+        rmss->setName("R.M.S.");
+        wMaxs->setName("Wind. Max.");
+        peaks->setMarkerSize(6.);
+        rmss->setMarkerSize(6.);
+        wMaxs->setMarkerSize(6.);
+        qint64 end = -1;
+        for (const t_TimelineBin &bin : bins)
+        {
+            const qint64 start = bin.index*w;
+            if (start != end)
+            {
+                if (end >= 0)
+                {
+                    upper->append(static_cast<qreal>(end), 0.);
+                    lower->append(static_cast<qreal>(end), 0.);
+                }
+                upper->append(static_cast<qreal>(start), 0.);
+                lower->append(static_cast<qreal>(start), 0.);
+            }
+            end = start + w;
+            upper->append(static_cast<qreal>(start), bin.envMax);
+            upper->append(static_cast<qreal>(end), bin.envMax);
+            lower->append(static_cast<qreal>(start), bin.envMin);
+            lower->append(static_cast<qreal>(end), bin.envMin);
+            yHi = qMax(yHi, static_cast<qreal>(bin.envMax));
+
+            if (bin.peak > 0.0f)
+            {
+                const qreal mid = static_cast<qreal>(start + w/2);
+                peaks->append(mid, bin.peak);
+                rmss->append(mid, bin.rms);
+                if (bin.wMax > 0.0f)
+                {
+                    wMaxs->append(mid, bin.wMax);
+                }
+                yHi = qMax(yHi, static_cast<qreal>(qMax(bin.peak, bin.wMax)));
+            }
+        }
+        if (end >= 0)
+        {
+            upper->append(static_cast<qreal>(end), 0.);
+            lower->append(static_cast<qreal>(end), 0.);
+        }
+
+        QAreaSeries *envelope = new QAreaSeries(upper, lower);
+        envelope->setName("Deviation");
+        theChart->addSeries(envelope);
+        envelope->attachAxis(xAxis);
+        envelope->attachAxis(yAxis);
+        for (QXYSeries *series : {static_cast<QXYSeries *>(peaks), static_cast<QXYSeries *>(rmss), static_cast<QXYSeries *>(wMaxs)})
+        {
+            theChart->addSeries(series);
+            series->attachAxis(xAxis);
+            series->attachAxis(yAxis);
+        }
+    }
+
+    xAxis->setRange(QDateTime::fromMSecsSinceEpoch(viewFrom, Qt::UTC),
+                    QDateTime::fromMSecsSinceEpoch(viewTo, Qt::UTC));
+    yAxis->setRange(0., yHi > 0. ? 1.05*yHi : 1.);
+}
+
+// Zoom about the time under the cursor
+void TimelineWidget::wheelEvent(QWheelEvent *event)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    const qint64 at = timeAt(event->position().toPoint());
+#else
+    const qint64 at = timeAt(event->pos());     // position() is from Qt 5.14
+#endif
+    const qreal factor = event->angleDelta().y() > 0 ? 0.5 : 2.0;
+    setView(at - qRound64((at - viewFrom)*factor), at + qRound64((viewTo - at)*factor));
+    event->accept();
+}
+
+void TimelineWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+    {
+        dragging = true;
+        dragStart = event->pos();
+        dragFrom = viewFrom;
+        event->accept();
+        return;
+    }
+    QChartView::mousePressEvent(event);
+}
+
+void TimelineWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (dragging)
+    {
+        const qreal width = chart()->plotArea().width();
+        if (width > 0.)
+        {
+            const qint64 span = viewTo - viewFrom;
+            const qint64 shift = qRound64((dragStart.x() - event->pos().x())*static_cast<qreal>(span)/width);
+            setView(dragFrom + shift, dragFrom + shift + span);
+        }
+        event->accept();
+        return;
+    }
+    QChartView::mouseMoveEvent(event);
+}
+
+void TimelineWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (dragging && event->button() == Qt::LeftButton)
+    {
+        dragging = false;
+        event->accept();
+        return;
+    }
+    QChartView::mouseReleaseEvent(event);
+}
+
+// Select the largest trace near the cursor, and zoom in until its samples show
+void TimelineWidget::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    const t_TimelinePyramid &tl = getTimeline();
+    const qint64 at = timeAt(event->pos());
+    const qreal width = qMax(1., chart()->plotArea().width());
+    const qint64 slack = qRound64(5.*static_cast<qreal>(viewTo - viewFrom)/width);   // a few pixels either side
+
+    int trace = -1;
+    float peak = -1.0f;
+    for (const t_TimelineBin &bin : tl.query(0, at - slack, at + slack))
+    {
+        if (bin.envMax > peak)
+        {
+            peak = bin.envMax;
+            trace = bin.trace;
+        }
+    }
+    event->accept();
+    if (trace < 0)
+        return;
+
+    t_Trace *p_t = getTrace(trace);
+    if (p_t != nullptr)
+    {
+        const qint64 t0 = p_t->dt.toMSecsSinceEpoch();
+        const qint64 length = qRound64(1000.*sampleCount(*p_t)/static_cast<qreal>(p_t->frequency));
+        const qint64 span = qMin(TimelineSampleSpan, qMax(length + 2000, viewTo - viewFrom));
+        setView(t0 + length/2 - span/2, t0 + length/2 + span/2);
+    }
+    emit traceActivated(trace);
+}
@@ -7,11 +7,16 @@
 #include <QtCharts/QChartView>
 #include <QFileSystemModel>
 #include <QFileDialog>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QSet>
 
 #include "loadtrace.h"
 
 QT_CHARTS_USE_NAMESPACE
 
+extern QVector<QPointF> traceSeries(const t_Trace &t1, unsigned int n, qreal t0, int maxPoints);
+
 class MyModel : public QFileSystemModel
 {
     Q_OBJECT
@@ -27,15 +32,31 @@ public:
 private:
     void set_x(unsigned int);
     void setTree(QTreeWidget * treeWidgetTopLevel);
+    void setLeaf(QTreeWidgetItem *leaf, int i);
+    void appendTree(int first);
     QDir  currentDirectory;
     bool  haveCurrentDirectory;
 
+    // Live mode: follow new and growing files in the current directory
+    bool  isLive;
+    QFileSystemWatcher *watcher;
+    QTimer *liveTimer;
+    QSet<QString> ignoredFiles;   // files that were present, but not opened, when going live
+
 public slots:
     void set_1(void);
     void set_0(void);
 
     void save(void);
     void open(void);
+
+    void setLive(bool live);
+    void refreshLive(void);
+
+    void query(void);
+    void report(void);
+    void applyRules(void);
+    void setWindowShape(int shape);
 };
 
 class TableWidget : public QChartView
@@ -44,7 +65,57 @@ class TableWidget : public QChartView
 
 public slots:
     void ShowTrace(QTreeWidgetItem *newItem);
+    void setSpectrumMode(bool on);
+
+private:
+    void ShowIndex(int index);
+    void ShowSpectrum(t_Trace *p_t);
+    int  currentIndex = -1;
+    bool spectrumMode = false;
+};
+
+class TelemetryWidget : public QChartView
+{
+    Q_OBJECT
+
+public slots:
+    void ShowTelemetry(void);
 
 };
 
+// Every trace of the campaign on one time axis, from the timeline pyramid.
+// The wheel zooms about the cursor, dragging pans, and a double click goes to
+// the trace under the cursor.
+class TimelineWidget : public QChartView
+{
+    Q_OBJECT
+
+public:
+    TimelineWidget(QWidget *parent = nullptr);
+
+public slots:
+    void ShowTimeline(void);
+
+signals:
+    void traceActivated(int index);
+
+protected:
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+private:
+    void setView(qint64 from, qint64 to);
+    void render(bool coarse);
+    qint64 timeAt(const QPoint &pos) const;
+    QTimer *fineTimer;
+    qint64 viewFrom = 0;    // ms since epoch
+    qint64 viewTo = 0;
+    bool   dragging = false;
+    QPoint dragStart;
+    qint64 dragFrom = 0;
+};
+
 #endif // TABLEWIDGET_H
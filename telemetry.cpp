@@ -0,0 +1,116 @@
+#include "telemetry.h"
+
+void t_Telemetry::clear(void)
+{
+    time.clear();
+    type.clear();
+    file.clear();
+    for (int ch = 0; ch < NumChannels; ch ++)
+    {
+        vals[ch].clear();
+    }
+    fileNames.clear();
+    hourly.clear();
+    hourlyIndex.clear();
+    daily.clear();
+    dailyIndex.clear();
+}
+
+void t_Telemetry::append(const t_Extra &extra)
+{
+    // Records come in file order, so the file is almost always the last one seen.
+    int f = fileNames.size() - 1;
+    if (f < 0 || fileNames.at(f) != extra.fileName)
+    {
+        f = fileNames.indexOf(extra.fileName);
+        if (f < 0)
+        {
+            fileNames.push_back(extra.fileName);
+            f = fileNames.size() - 1;
+        }
+    }
+
+    time.push_back(extra.dt.toMSecsSinceEpoch());
+    type.push_back(static_cast<quint8>(extra.type));
+    file.push_back(f);
+    vals[VBat].push_back(extra.v_bat);
+    vals[Temp1].push_back(extra.temp_1);
+    vals[Temp2].push_back(extra.temp_2);
+    vals[Temp3].push_back(extra.temp_3);
+
+    addToRollups(hourly, hourlyIndex, Hourly, time.size() - 1);
+    addToRollups(daily, dailyIndex, Daily, time.size() - 1);
+}
+
+t_Extra t_Telemetry::at(int index) const
+{
+    t_Extra extra;
+    extra.type = static_cast<t_ExtraType>(type.at(index));
+    extra.dt = QDateTime::fromMSecsSinceEpoch(time.at(index), Qt::UTC);
+    extra.fileName = fileNames.at(file.at(index));
+    extra.v_bat = vals[VBat].at(index);
+    extra.temp_1 = vals[Temp1].at(index);
+    extra.temp_2 = vals[Temp2].at(index);
+    extra.temp_3 = vals[Temp3].at(index);
+    return extra;
+}
+
+void t_Telemetry::addToRollups(QVector<t_Rollup> &rollups, QMap<qint64, int> &index, qint64 period, int row)
+{
+    qint64 t = time.at(row);
+    qint64 start = t - (((t % (period*1000)) + period*1000) % (period*1000));  // round down, also before 1970
+
+    int r;
+    if (!rollups.isEmpty() && rollups.last().start == start)
+    {
+        r = rollups.size() - 1;
+    }
+    else if (index.contains(start))
+    {
+        r = index.value(start);
+    }
+    else
+    {
+        t_Rollup n;
+        n.start = start;
+        for (int ch = 0; ch < NumChannels; ch ++)
+        {
+            n.count[ch] = 0;
+            n.min[ch] = 0.0f;
+            n.max[ch] = 0.0f;
+            n.sum[ch] = 0.;
+        }
+        rollups.push_back(n);
+        r = rollups.size() - 1;
+        index.insert(start, r);
+    }
+
+    t_Rollup &u = rollups[r];
+    for (int ch = 0; ch < NumChannels; ch ++)
+    {
+        float v = vals[ch].at(row);
+        if (v == -1.0f)  // not present in the record
+            continue;
+        if (u.count[ch] == 0 || v < u.min[ch])
+            u.min[ch] = v;
+        if (u.count[ch] == 0 || v > u.max[ch])
+            u.max[ch] = v;
+        u.sum[ch] += static_cast<qreal>(v);
+        u.count[ch] ++;
+    }
+}
+
+// Rollups in time order
+t_Rollups t_Telemetry::rollups(t_RollupPeriod period) const
+{
+    const QVector<t_Rollup> &from = (period == Hourly) ? hourly : daily;
+    const QMap<qint64, int> &index = (period == Hourly) ? hourlyIndex : dailyIndex;
+
+    t_Rollups res;
+    res.reserve(from.size());
+    for (QMap<qint64, int>::const_iterator it = index.constBegin(); it != index.constEnd(); ++ it)
+    {
+        res.push_back(from.at(it.value()));
+    }
+    return res;
+}
@@ -0,0 +1,73 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <QDateTime>
+#include <QVector>
+#include <QStringList>
+#include <QMap>
+
+#include "loadtrace.h"
+
+// Channels of the heartbeat/ON records
+typedef enum
+{
+    VBat = 0,
+    Temp1 = 1,
+    Temp2 = 2,
+    Temp3 = 3,
+    NumChannels = 4
+} t_TelemetryChannel;
+
+// Length of a rollup period, in seconds
+typedef enum
+{
+    Hourly = 3600,
+    Daily = 86400
+} t_RollupPeriod;
+
+// Minimum/maximum/mean of each channel over one period. Missing readings (-1)
+// are not counted.
+class t_Rollup
+{
+public:
+    qint64 start;                   // ms since epoch, UTC
+    int    count[NumChannels];
+    float  min[NumChannels];
+    float  max[NumChannels];
+    qreal  sum[NumChannels];
+
+    float mean(int ch) const { return (count[ch] > 0) ? static_cast<float>(sum[ch]/count[ch]) : -1.0f; }
+};
+
+typedef QVector<t_Rollup> t_Rollups;
+
+// Heartbeat and ON records, stored as one array per field. Hourly and daily
+// rollups are kept up to date as records are appended.
+class t_Telemetry
+{
+public:
+    void clear(void);
+    void append(const t_Extra &extra);
+    int  size(void) const { return time.size(); }
+    t_Extra at(int index) const;
+
+    t_Rollups rollups(t_RollupPeriod period) const;
+
+    QVector<qint64>  time;          // ms since epoch, UTC
+    QVector<quint8>  type;          // t_ExtraType
+    QVector<int>     file;          // index into fileNames
+    QVector<float>   vals[NumChannels];
+    QStringList      fileNames;
+
+private:
+    void addToRollups(QVector<t_Rollup> &rollups, QMap<qint64, int> &index, qint64 period, int row);
+
+    QVector<t_Rollup>  hourly;
+    QMap<qint64, int>  hourlyIndex;   // start of period -> index in hourly
+    QVector<t_Rollup>  daily;
+    QMap<qint64, int>  dailyIndex;
+};
+
+extern const t_Telemetry &getTelemetry(void);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,240 @@
+#include <algorithm>
+
+#include "loadtrace.h"
+#include "timeline.h"
+
+static t_TimelinePyramid Timeline;
+static bool TimelineValid = false;
+
+// Called when the traces are loaded afresh. The pyramid is only rebuilt when
+// it's next wanted.
+void invalidateTimeline(void)
+{
+    TimelineValid = false;
+}
+
+// Called when the wMax of trace "index" changes
+void updateTimeline(int index)
+{
+    if (TimelineValid)
+    {
+        Timeline.updateTrace(index);
+    }
+}
+
+const t_TimelinePyramid &getTimeline(void)
+{
+    if (!TimelineValid)
+    {
+        Timeline.build();
+        TimelineValid = true;
+    }
+    else if (traceCount() > Timeline.traces)
+    {
+        Timeline.append();
+    }
+    return Timeline;
+}
+
+// Combine b into a, which covers the same or a wider bin
+static void mergeBin(t_TimelineBin &a, const t_TimelineBin &b)
+{
+    a.envMin = qMin(a.envMin, b.envMin);
+    a.envMax = qMax(a.envMax, b.envMax);
+    if (b.peak > a.peak)
+    {
+        a.peak = b.peak;
+        a.trace = b.trace;
+    }
+    a.rms = qMax(a.rms, b.rms);
+    a.wMax = qMax(a.wMax, b.wMax);
+}
+
+// Sort by index, and combine bins with the same index
+static void compact(t_TimelineLevel &level)
+{
+    std::stable_sort(level.begin(), level.end(), [](const t_TimelineBin &a, const t_TimelineBin &b) { return a.index < b.index; });
+    int out = 0;
+    for (int i = 0; i < level.size(); i ++)
+    {
+        if (out > 0 && level.at(out - 1).index == level.at(i).index)
+        {
+            mergeBin(level[out - 1], level.at(i));
+        }
+        else
+        {
+            level[out ++] = level.at(i);
+        }
+    }
+    level.resize(out);
+}
+
+void t_TimelinePyramid::build(void)
+{
+    pyramid.clear();
+    startBin.clear();
+    startingIn.clear();
+    traces = 0;
+    first = last = 0;
+
+    // Level 0 from the samples. Traces are nearly always in time order, so
+    // there's little left to sort.
+    t_TimelineLevel base;
+    for (int n = traceCount(), i = 0; i < n; i ++)
+    {
+        addTrace(i, base);
+    }
+    buildLevels(base);
+}
+
+// Add the traces appended since the pyramid was built. Only their samples are
+// gone through; the levels above level 0 are made again from its bins.
+void t_TimelinePyramid::append(void)
+{
+    t_TimelineLevel base = pyramid.isEmpty() ? t_TimelineLevel() : pyramid.first();
+    for (int n = traceCount(), i = traces; i < n; i ++)
+    {
+        addTrace(i, base);
+    }
+    buildLevels(base);
+}
+
+// Add the level 0 bins of trace i to "base"
+void t_TimelinePyramid::addTrace(int i, t_TimelineLevel &base)
+{
+    const t_Trace * p_t = getTrace(i);
+    traces ++;
+    QVector<qreal> env = ValsToRms(*p_t);
+    const qint64 t0 = p_t->dt.toMSecsSinceEpoch();
+    const qreal msPerSample = 1000./static_cast<qreal>(p_t->frequency);
+    const qint64 tEnd = t0 + qRound64(env.size()*msPerSample);
+    if (traces == 1 || t0 < first)
+        first = t0;
+    if (traces == 1 || tEnd > last)
+        last = tEnd;
+
+    t_TimelineBin bin;
+    bin.index = t0/BaseWidth;
+    bin.envMin = 1.e30f;
+    bin.envMax = 0.0f;
+    bin.peak = p_t->maximumDeviation;
+    bin.rms = p_t->rmsDeviation;
+    bin.wMax = p_t->wMax;
+    bin.trace = i;
+    startBin.push_back(bin.index);
+    startingIn.insert(bin.index, i);
+    for (int k = 0; k < env.size(); k ++)
+    {
+        qint64 index = (t0 + qRound64(k*msPerSample))/BaseWidth;
+        if (index != bin.index)
+        {
+            base.push_back(bin);
+            bin.index = index;
+            bin.envMin = 1.e30f;
+            bin.envMax = 0.0f;
+            bin.peak = bin.rms = bin.wMax = 0.0f;   // only the bin the trace starts in holds its values
+        }
+        float e = 16384.0f*static_cast<float>(env.at(k));
+        bin.envMin = qMin(bin.envMin, e);
+        bin.envMax = qMax(bin.envMax, e);
+    }
+    if (!env.isEmpty())
+    {
+        base.push_back(bin);
+    }
+}
+
+void t_TimelinePyramid::buildLevels(t_TimelineLevel &base)
+{
+    pyramid.clear();
+    compact(base);
+    if (base.isEmpty())
+        return;
+    pyramid.push_back(base);
+
+    // Each level from the one below, until one bin covers everything
+    while (pyramid.last().size() > 1 && pyramid.size() < 48)
+    {
+        const t_TimelineLevel &below = pyramid.last();
+        t_TimelineLevel level;
+        level.reserve(below.size()/2 + 1);
+        for (int i = 0; i < below.size(); i ++)
+        {
+            qint64 index = below.at(i).index >> 1;
+            if (!level.isEmpty() && level.last().index == index)
+            {
+                mergeBin(level.last(), below.at(i));
+            }
+            else
+            {
+                level.push_back(below.at(i));
+                level.last().index = index;
+            }
+        }
+        pyramid.push_back(level);
+    }
+}
+
+t_TimelineBin *t_TimelinePyramid::findBin(int level, qint64 index)
+{
+    t_TimelineLevel &l = pyramid[level];
+    auto it = std::lower_bound(l.begin(), l.end(), index, [](const t_TimelineBin &b, qint64 i) { return b.index < i; });
+    return (it != l.end() && it->index == index) ? &*it : nullptr;
+}
+
+// Put right the wMax of the bins that trace i starts in, at every level
+void t_TimelinePyramid::updateTrace(int i)
+{
+    if (i < 0 || i >= startBin.size() || pyramid.isEmpty())
+        return;
+
+    qint64 index = startBin.at(i);
+    t_TimelineBin *bin = findBin(0, index);
+    if (bin == nullptr)
+        return;
+    float w = 0.0f;
+    foreach (int j, startingIn.values(index))
+    {
+        w = qMax(w, getTrace(j)->wMax);
+    }
+    bin->wMax = w;
+
+    for (int level = 1; level < pyramid.size(); level ++)
+    {
+        index >>= 1;
+        bin = findBin(level, index);
+        if (bin == nullptr)
+            return;
+        const t_TimelineBin *lo = findBin(level - 1, 2*index);
+        const t_TimelineBin *hi = findBin(level - 1, 2*index + 1);
+        bin->wMax = qMax(lo != nullptr ? lo->wMax : 0.0f, hi != nullptr ? hi->wMax : 0.0f);
+    }
+}
+
+// The finest level that covers "span" ms in no more than "bins" bins
+int t_TimelinePyramid::levelFor(qint64 span, int bins) const
+{
+    int level = 0;
+    while (level < pyramid.size() - 1 && span/width(level) > bins)
+    {
+        level ++;
+    }
+    return level;
+}
+
+// The non-empty bins of a level that overlap from..to
+t_TimelineLevel t_TimelinePyramid::query(int level, qint64 from, qint64 to) const
+{
+    t_TimelineLevel result;
+    if (level < 0 || level >= pyramid.size())
+        return result;
+
+    const t_TimelineLevel &l = pyramid.at(level);
+    const qint64 w = width(level);
+    auto lo = std::lower_bound(l.constBegin(), l.constEnd(), from/w, [](const t_TimelineBin &b, qint64 index) { return b.index < index; });
+    for (auto it = lo; it != l.constEnd() && it->index*w <= to; ++ it)
+    {
+        result.push_back(*it);
+    }
+    return result;
+}
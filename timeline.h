@@ -0,0 +1,62 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <QMultiHash>
+#include <QVector>
+#include <QtGlobal>
+
+// Summary of the samples and traces within one bin of time
+class t_TimelineBin
+{
+public:
+    qint64 index;           // the bin starts at index*width of its level
+    float  envMin;          // smallest and largest deviation of any sample, measurement units
+    float  envMax;
+    float  peak;            // largest of the traces starting in the bin, 0 if there are none
+    float  rms;
+    float  wMax;
+    int    trace;           // a trace within the bin: the one with the largest deviation
+};
+
+// Bins in index order. Bins with no samples are left out, as the traces are
+// sparse in time.
+typedef QVector<t_TimelineBin> t_TimelineLevel;
+
+// Min/max pyramid over the loaded traces. Each level has bins twice as wide as
+// the level below, and is made from it, so that any time range can be plotted
+// from about as many bins as there are pixels.
+class t_TimelinePyramid
+{
+public:
+    static const qint64 BaseWidth = 1000;    // ms, of the bins of level 0
+
+    void build(void);
+    void append(void);
+    void updateTrace(int i);
+    int  levels(void) const { return pyramid.size(); }
+    qint64 width(int level) const { return BaseWidth << level; }
+    int  levelFor(qint64 span, int bins) const;
+    t_TimelineLevel query(int level, qint64 from, qint64 to) const;
+
+    qint64 first = 0;       // ms since epoch, of the first and last samples
+    qint64 last = 0;
+    int    traces = 0;      // traces it was built from
+
+private:
+    void addTrace(int i, t_TimelineLevel &base);
+    void buildLevels(t_TimelineLevel &base);
+    t_TimelineBin *findBin(int level, qint64 index);
+
+    QVector<t_TimelineLevel> pyramid;
+    QVector<qint64> startBin;           // per trace, the level 0 bin it starts in
+    QMultiHash<qint64, int> startingIn; // the traces starting in each level 0 bin
+};
+
+// The pyramid is made when first wanted, and added to as traces are appended.
+// Only loading from scratch needs it thrown away: the sample envelopes don't
+// depend on exclusions, and a changed wMax is put right by updateTimeline().
+extern const t_TimelinePyramid &getTimeline(void);
+extern void invalidateTimeline(void);
+extern void updateTimeline(int index);
+
+#endif // TIMELINE_H
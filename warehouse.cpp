@@ -0,0 +1,359 @@
+#include <QDir>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStandardPaths>
+#include <QVariant>
+#include <QtMath>
+#include <QMap>
+#include <QSet>
+
+#include "loadtrace.h"
+#include "exceedance.h"
+#include "telemetry.h"
+#include "window.h"
+#include "resample.h"
+#include "warehouse.h"
+
+static const char * const Connection = "warehouse";
+static bool WarehouseOpen = false;
+static int  StoredTelemetry = 0;     // telemetry records already stored
+
+static const qint64 SecsPerDay = 86400;
+
+QString defaultWarehousePath(void)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dir);
+    return QDir(dir).filePath("Warehouse.sqlite");
+}
+
+bool haveWarehouse(void)
+{
+    return WarehouseOpen;
+}
+
+bool openWarehouse(QString path)
+{
+    QSqlDatabase db = QSqlDatabase::contains(Connection) ? QSqlDatabase::database(Connection, false)
+                                                         : QSqlDatabase::addDatabase("QSQLITE", Connection);
+    db.close();
+    db.setDatabaseName(path);
+    WarehouseOpen = db.open();
+    if (!WarehouseOpen)
+        return false;
+
+    // Every row belongs to a source: the absolute path of the data directory it
+    // came from. File names (dates) alone repeat between loggers. Warehouses
+    // from before sources were kept are started again.
+    QSqlQuery query(db);
+    if (db.tables().contains("trace_summary") && !db.record("trace_summary").contains("source"))
+    {
+        foreach (QString table, QStringList() << "trace_summary" << "exceedance" << "vdv_period" << "telemetry"
+                                              << "rollup_daily" << "rollup_weekly")
+        {
+            query.exec("drop table if exists " + table);
+        }
+    }
+
+    // Times are seconds since the epoch (UTC), as in Exclude.sqlite, except for
+    // exceedances, which are to the millisecond.
+    query.exec("create table if not exists trace_summary (source text, filename text, datetime bigint, frequency real, "
+                                                         "max real, rms real, wmax real, fourth real, maxaxis int, "
+                                                         "domfreq real, exclusion int, primary key (source, filename, datetime))");
+    query.exec("create index if not exists trace_summary_datetime on trace_summary (source, datetime)");
+    query.exec("create table if not exists exceedance (source text, filename text, start_ms bigint, channel int, threshold real, "
+                                                      "duration real, peak real, primary key (source, filename, start_ms, channel, threshold))");
+    query.exec("create index if not exists exceedance_start on exceedance (source, start_ms)");
+    query.exec("create table if not exists telemetry (source text, filename text, datetime bigint, type int, "
+                                                     "vbat real, temp1 real, temp2 real, temp3 real, primary key (source, filename, datetime, type))");
+    query.exec("create index if not exists telemetry_datetime on telemetry (source, datetime)");
+
+    // What each file adds to the sum of 4th powers of each VDV period. A period
+    // can span two files, and either can be stored without the other.
+    query.exec("create table if not exists vdv_file (source text, filename text, start bigint, end bigint, sum4th real, "
+                                                    "primary key (source, filename, start))");
+    query.exec("create view if not exists vdv_period as select source, start, max(end) as end, sum(sum4th) as sum4th "
+                                                        "from vdv_file group by source, start");
+
+    // The settings each source's results were worked out with
+    query.exec("create table if not exists source_parameters (source text primary key, parameters text)");
+
+    // Materialised rollups. VDVs are kept as sums of 4th powers so that they can be combined.
+    QString rollup = " (source text, start bigint, traces int, excluded int, max_max real, mean_rms real, max_wmax real, "
+                     "day_sum4th real, night_sum4th real, exceedances int, primary key (source, start))";
+    query.exec("create table if not exists rollup_daily" + rollup);
+    query.exec("create table if not exists rollup_weekly" + rollup);
+
+    StoredTelemetry = 0;
+    return true;
+}
+
+static qint64 dayOf(qint64 secs)
+{
+    return secs - (((secs % SecsPerDay) + SecsPerDay) % SecsPerDay);
+}
+
+// Weeks start on Monday. 1/1/1970 was a Thursday.
+static qint64 weekOf(qint64 secs)
+{
+    qint64 day = dayOf(secs)/SecsPerDay + 3;
+    return (day - (((day % 7) + 7) % 7) - 3)*SecsPerDay;
+}
+
+// Recalculate the daily rollups of one source for the days in [d0, d1), then
+// the weekly ones covering them.
+static void updateRollups(QSqlDatabase &db, const QString &source, qint64 d0, qint64 d1)
+{
+    QSqlQuery query(db);
+    query.prepare("delete from rollup_daily where source = :source and start >= :d0 and start < :d1");
+    query.bindValue(":source", source);
+    query.bindValue(":d0", d0);
+    query.bindValue(":d1", d1);
+    query.exec();
+
+    query.prepare("insert into rollup_daily "
+                  "select source, (datetime - datetime % 86400) as day, count(*), sum(exclusion > 0), max(max), avg(rms), max(wmax), "
+                  "(select sum4th from vdv_period v where v.source = trace_summary.source "
+                                                       "and v.start = (datetime - datetime % 86400) + 25200), "    // 7 AM
+                  "(select sum4th from vdv_period v where v.source = trace_summary.source "
+                                                       "and v.start = (datetime - datetime % 86400) + 82800), "    // 11 PM
+                  "(select count(*) from exceedance e where e.source = trace_summary.source "
+                                                      "and e.start_ms >= (datetime - datetime % 86400)*1000 "
+                                                      "and e.start_ms < (datetime - datetime % 86400 + 86400)*1000) "
+                  "from trace_summary where source = :source and datetime >= :d0 and datetime < :d1 group by day");
+    query.bindValue(":source", source);
+    query.bindValue(":d0", d0);
+    query.bindValue(":d1", d1);
+    query.exec();
+
+    qint64 w0 = weekOf(d0);
+    qint64 w1 = weekOf(d1 - 1) + 7*SecsPerDay;
+    query.prepare("delete from rollup_weekly where source = :source and start >= :w0 and start < :w1");
+    query.bindValue(":source", source);
+    query.bindValue(":w0", w0);
+    query.bindValue(":w1", w1);
+    query.exec();
+
+    query.prepare("insert into rollup_weekly "
+                  "select source, ((start/86400 + 3) - (start/86400 + 3) % 7 - 3)*86400 as week, sum(traces), sum(excluded), max(max_max), "
+                  "sum(mean_rms*traces)/sum(traces), max(max_wmax), sum(day_sum4th), sum(night_sum4th), sum(exceedances) "
+                  "from rollup_daily where source = :source and start >= :w0 and start < :w1 group by week");
+    query.bindValue(":source", source);
+    query.bindValue(":w0", w0);
+    query.bindValue(":w1", w1);
+    query.exec();
+}
+
+// Replace what the given files add to each VDV period, from all of their loaded
+// traces. Files are always loaded whole, so these are their complete sums.
+static void storeVdvOfFiles(QSqlDatabase &db, const QString &source, const QSet<QString> &files)
+{
+    class t_Part
+    {
+    public:
+        qint64 end = 0;
+        qreal  sum4th = 0.;
+    };
+    QMap<QString, QMap<qint64, t_Part>> parts;     // by file, then period start
+
+    t_Trace * p_t;
+    for (int i = 0; (p_t = getTrace(i)) != nullptr; i ++)
+    {
+        if (!files.contains(p_t->fileName))
+            continue;
+        QDateTime start, end;
+        vdvPeriodBounds(p_t->dt, start, end);
+        t_Part &part = parts[p_t->fileName][start.toSecsSinceEpoch()];
+        part.end = end.toSecsSinceEpoch();
+        part.sum4th += vdvContribution(*p_t);
+    }
+
+    QSqlQuery query(db);
+    foreach (const QString &file, files)
+    {
+        query.prepare("delete from vdv_file where source = :source and filename = :filename");
+        query.bindValue(":source", source);
+        query.bindValue(":filename", file);
+        query.exec();
+    }
+    query.prepare("insert into vdv_file values (:source, :filename, :start, :end, :sum4th)");
+    for (auto f = parts.constBegin(); f != parts.constEnd(); ++ f)
+    {
+        for (auto p = f.value().constBegin(); p != f.value().constEnd(); ++ p)
+        {
+            query.bindValue(":source", source);
+            query.bindValue(":filename", f.key());
+            query.bindValue(":start", p.key());
+            query.bindValue(":end", p.value().end);
+            query.bindValue(":sum4th", p.value().sum4th);
+            query.exec();
+        }
+    }
+}
+
+// The settings that the stored results depend on, as text: the exceedance
+// levels, the window and the resampling frequency.
+static QString analysisParameters(void)
+{
+    QStringList p;
+    foreach (const t_ExceedanceLevel &l, getExceedanceScanner().levels())
+    {
+        p << QString("%1/%2").arg(static_cast<qreal>(l.threshold)).arg(static_cast<qreal>(l.hysteresis));
+    }
+    p << WindowShapeNames[windowShape()] << QString::number(windowSeconds()) << QString::number(static_cast<qreal>(resampleFrequency()));
+    return p.join(",");
+}
+
+// Store the traces [first, last) (to the end if last < 0) of the data directory
+// "dir", their exceedances, telemetry not stored yet and the VDV sums of their
+// files, then bring the rollups of the days they cover up to date. All in one
+// transaction. If the settings have changed since the source was last stored,
+// its results so far are out of date, so they're all deleted and every loaded
+// trace is stored again.
+void storeInWarehouse(QDir dir, int first, int last)
+{
+    if (!WarehouseOpen)
+        return;
+
+    const QString source = dir.absolutePath();
+    QSqlDatabase db = QSqlDatabase::database(Connection);
+    db.transaction();
+
+    QSqlQuery query(db);
+    const QString parameters = analysisParameters();
+    query.prepare("select parameters from source_parameters where source = :source");
+    query.bindValue(":source", source);
+    query.exec();
+    if (!query.first() || query.value(0).toString() != parameters)
+    {
+        foreach (QString table, QStringList() << "trace_summary" << "exceedance" << "vdv_file" << "telemetry"
+                                              << "rollup_daily" << "rollup_weekly")
+        {
+            query.prepare("delete from " + table + " where source = :source");
+            query.bindValue(":source", source);
+            query.exec();
+        }
+        query.prepare("insert or replace into source_parameters values (:source, :parameters)");
+        query.bindValue(":source", source);
+        query.bindValue(":parameters", parameters);
+        query.exec();
+        first = 0;
+        last = -1;
+    }
+
+    query.prepare("insert or replace into trace_summary values (:source, :filename, :datetime, :frequency, :max, :rms, :wmax, "
+                                                              ":fourth, :maxaxis, :domfreq, :exclusion)");
+    qint64 t0 = -1, t1 = -1;
+    QSet<QString> files;
+    t_Trace * p_t;
+    int i;
+    for (i = first; (last < 0 || i < last) && (p_t = getTrace(i)) != nullptr; i ++)
+    {
+        qint64 t = p_t->dt.toSecsSinceEpoch();
+        if (t0 < 0 || t < t0)
+            t0 = t;
+        if (t > t1)
+            t1 = t;
+        files.insert(p_t->fileName);
+        query.bindValue(":source", source);
+        query.bindValue(":filename", p_t->fileName);
+        query.bindValue(":datetime", t);
+        query.bindValue(":frequency", p_t->frequency);
+        query.bindValue(":max", p_t->maximumDeviation);
+        query.bindValue(":rms", p_t->rmsDeviation);
+        query.bindValue(":wmax", p_t->wMax);
+        query.bindValue(":fourth", p_t->total4thPowerDeviation);
+        query.bindValue(":maxaxis", p_t->maxAxis);
+        query.bindValue(":domfreq", p_t->dominantFrequency);
+        query.bindValue(":exclusion", p_t->exclusion);
+        query.exec();
+    }
+    last = i;
+
+    const t_ExceedanceScanner &scanner = getExceedanceScanner();
+    query.prepare("insert or replace into exceedance values (:source, :filename, :start_ms, :channel, :threshold, :duration, :peak)");
+    foreach (const t_Exceedance &e, scanner.exceedances())
+    {
+        if (e.trace < first || e.trace >= last)
+            continue;
+        p_t = getTrace(e.trace);
+        query.bindValue(":source", source);
+        query.bindValue(":filename", p_t->fileName);
+        query.bindValue(":start_ms", e.startTime(p_t->dt, p_t->frequency).toMSecsSinceEpoch());
+        query.bindValue(":channel", e.channel);
+        query.bindValue(":threshold", scanner.levels().at(e.level).threshold);
+        query.bindValue(":duration", static_cast<qreal>(e.samples)/static_cast<qreal>(p_t->frequency));
+        query.bindValue(":peak", e.peak);
+        query.exec();
+    }
+
+    const t_Telemetry &tel = getTelemetry();
+    if (first == 0 || StoredTelemetry > tel.size())
+    {
+        StoredTelemetry = 0;
+    }
+    query.prepare("insert or replace into telemetry values (:source, :filename, :datetime, :type, :vbat, :temp1, :temp2, :temp3)");
+    for (int r = StoredTelemetry; r < tel.size(); r ++)
+    {
+        query.bindValue(":source", source);
+        query.bindValue(":filename", tel.fileNames.at(tel.file.at(r)));
+        query.bindValue(":datetime", tel.time.at(r)/1000);
+        query.bindValue(":type", tel.type.at(r));
+        query.bindValue(":vbat", tel.vals[VBat].at(r));
+        query.bindValue(":temp1", tel.vals[Temp1].at(r));
+        query.bindValue(":temp2", tel.vals[Temp2].at(r));
+        query.bindValue(":temp3", tel.vals[Temp3].at(r));
+        query.exec();
+    }
+    StoredTelemetry = tel.size();
+
+    storeVdvOfFiles(db, source, files);
+
+    if (t0 >= 0)
+    {
+        // A night period runs into the next day, so its rollup is a day earlier than its traces
+        updateRollups(db, source, dayOf(t0) - SecsPerDay, dayOf(t1) + SecsPerDay);
+    }
+
+    db.commit();
+}
+
+// Write the daily (or weekly) rollups that start within from..to, straight from the warehouse.
+bool exportRollups(QTextStream &out, bool weekly, QDateTime from, QDateTime to)
+{
+    if (!WarehouseOpen)
+        return false;
+
+    QSqlQuery query(QSqlDatabase::database(Connection));
+    query.prepare(QString("select source, start, traces, excluded, max_max, mean_rms, max_wmax, day_sum4th, night_sum4th, exceedances "
+                          "from %1 where start >= :from and start <= :to order by source, start").arg(weekly ? "rollup_weekly" : "rollup_daily"));
+    query.bindValue(":from", from.isValid() ? from.toSecsSinceEpoch() : Q_INT64_C(-9223372036854775807));
+    query.bindValue(":to", to.isValid() ? to.toSecsSinceEpoch() : Q_INT64_C(9223372036854775807));
+    if (!query.exec())
+        return false;
+
+    out << "Source,Start,Traces,Excluded,Max.,Mean RMS,Max. Windowed Max.,VDV day [m s^-1.75],VDV night [m s^-1.75],Exceedances" << "\n";
+    while (query.next())
+    {
+        out << query.value(0).toString()
+            << "," << QDateTime::fromSecsSinceEpoch(query.value(1).toLongLong(), Qt::UTC).toString("dd/MM/yyyy")
+            << "," << query.value(2).toInt()
+            << "," << query.value(3).toInt()
+            << "," << QString::number(query.value(4).toDouble())
+            << "," << QString::number(query.value(5).toDouble())
+            << "," << QString::number(query.value(6).toDouble())
+            << ",";
+        if (!query.value(7).isNull())
+        {
+            out << QString::number(qPow(query.value(7).toDouble(), 0.25));
+        }
+        out << ",";
+        if (!query.value(8).isNull())
+        {
+            out << QString::number(qPow(query.value(8).toDouble(), 0.25));
+        }
+        out << "," << query.value(9).toInt() << "\n";
+    }
+    return true;
+}
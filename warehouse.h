@@ -0,0 +1,26 @@
+#ifndef WAREHOUSE_H
+#define WAREHOUSE_H
+
+#include <QDateTime>
+#include <QDir>
+#include <QString>
+#include <QTextStream>
+
+/*
+    A long-term store of processed results, in an SQLite file of its own (not
+    Exclude.sqlite, which belongs to a data directory). Per-trace summaries,
+    exceedances, VDV periods and telemetry are added to it as they're
+    calculated, along with daily and weekly rollups, so that long-range
+    questions can be answered without going back to the .CSV files. Results
+    worked out with other settings (exceedance levels, window, resampling)
+    replace those stored for a source before.
+*/
+
+extern QString defaultWarehousePath(void);
+extern bool openWarehouse(QString path);
+extern bool haveWarehouse(void);
+
+extern void storeInWarehouse(QDir dir, int first, int last = -1);
+extern bool exportRollups(QTextStream &out, bool weekly, QDateTime from, QDateTime to);
+
+#endif // WAREHOUSE_H
@@ -0,0 +1,110 @@
+#include <cmath>
+
+#include <QString>
+
+#include "loadtrace.h"
+#include "window.h"
+
+const char * const WindowShapeNames[NumWindowShapes] = {"blackman", "hann", "flattop"};
+
+static t_WindowShape Shape = WindowBlackman;
+static qreal Seconds = 22.0/125.0;
+
+// The original 22-point Blackman window summed to 9.24
+static_assert(WindowTable<WindowBlackman, 22>.sum > 9.2399 && WindowTable<WindowBlackman, 22>.sum < 9.2401, "Blackman window sum");
+
+int windowShapeFromName(const QString &name)
+{
+    for (int s = 0; s < NumWindowShapes; s ++)
+    {
+        if (name.compare(WindowShapeNames[s], Qt::CaseInsensitive) == 0)
+        {
+            return s;
+        }
+    }
+    return -1;
+}
+
+// The windowed peaks kept with the traces were made with the old window, so
+// they're thrown away, and the windowed maximums of the events made again.
+void setWindow(t_WindowShape shape, qreal seconds)
+{
+    Shape = shape;
+    Seconds = seconds;
+
+    t_Trace *p_t;
+    for (int i = 0; (p_t = getTrace(i)) != nullptr; i ++)
+    {
+        p_t->wPeak = -1.;
+    }
+    addWindowedMax();
+}
+
+t_WindowShape windowShape(void)
+{
+    return Shape;
+}
+
+qreal windowSeconds(void)
+{
+    return Seconds;
+}
+
+int windowLength(float frequency)
+{
+    return qMax(2, qRound(Seconds*static_cast<qreal>(frequency)));
+}
+
+template <int M>
+static qreal kernelOfShape(const qreal *x, int n)
+{
+    switch (Shape)
+    {
+    case WindowHann:
+        return windowedPeakKernel<WindowHann, M>(x, n);
+    case WindowFlatTop:
+        return windowedPeakKernel<WindowFlatTop, M>(x, n);
+    default:
+        return windowedPeakKernel<WindowBlackman, M>(x, n);
+    }
+}
+
+// Windowed peak of a 1-dimensional trace sampled at "frequency". The lengths
+// of the usual sample rates (125, 250 and 500 Hz) have kernels of their own.
+qreal windowedPeakOf(const QVector<qreal> &x, float frequency)
+{
+    const int M = windowLength(frequency);
+    switch (M)
+    {
+    case 22:
+        return kernelOfShape<22>(x.constData(), x.size());
+    case 44:
+        return kernelOfShape<44>(x.constData(), x.size());
+    case 88:
+        return kernelOfShape<88>(x.constData(), x.size());
+    default:
+        break;
+    }
+
+    QVector<qreal> w;
+    qreal sum = 0.;
+    for (int i = 1; i < M; i ++)
+    {
+        w.push_back(windowCoefficient(Shape, i, M));
+        sum += w.last();
+    }
+    qreal max_y = 0.;
+    for (int j = 0; j + w.size() <= x.size(); j ++)
+    {
+        qreal y = 0.;
+        for (int i = 0; i < w.size(); i ++)
+        {
+            y += w.at(i)*x.at(j + i);
+        }
+        if (y > max_y)
+        {
+            max_y = y;
+        }
+    }
+    return max_y/sum;
+}
@@ -0,0 +1,105 @@
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include <QVector>
+#include <QtMath>
+
+// Windows for the windowed maximum. The window lasts a fixed time, so its
+// length in samples depends on the sample rate: 22 samples at 125 Hz by default.
+typedef enum
+{
+    WindowBlackman = 0,
+    WindowHann,
+    WindowFlatTop,
+    NumWindowShapes
+
+} t_WindowShape;
+
+extern const char * const WindowShapeNames[NumWindowShapes];
+extern int windowShapeFromName(const QString &name);    // -1 if not known
+
+// cos() that can be evaluated at compile time: a Taylor series, after bringing
+// x into -pi .. pi
+constexpr qreal constCos(qreal x)
+{
+    while (x > M_PI)
+    {
+        x -= 2*M_PI;
+    }
+    while (x < -M_PI)
+    {
+        x += 2*M_PI;
+    }
+    qreal term = 1.;
+    qreal sum = 1.;
+    for (int k = 1; k < 20; k ++)
+    {
+        term *= -x*x/static_cast<qreal>((2*k - 1)*(2*k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Point i of an M-point window, for i = 1 .. (M-1). Outside that, it is zero.
+constexpr qreal windowCoefficient(t_WindowShape shape, int i, int M)
+{
+    const qreal x = 2*M_PI*static_cast<qreal>(i)/static_cast<qreal>(M);
+    return (shape == WindowHann)    ? 0.5 - 0.5*constCos(x)
+         : (shape == WindowFlatTop) ? 0.21557895 - 0.41663158*constCos(x) + 0.277263158*constCos(2*x)
+                                      - 0.083578947*constCos(3*x) + 0.006947368*constCos(4*x)
+         :                            0.42 - 0.50*constCos(x) + 0.08*constCos(2*x);
+}
+
+// The non-zero points of a window and their sum, made by the compiler
+template <t_WindowShape Shape, int M>
+class t_WindowTable
+{
+public:
+    constexpr t_WindowTable() : c(), sum(0.)
+    {
+        for (int i = 1; i < M; i ++)
+        {
+            c[i - 1] = windowCoefficient(Shape, i, M);
+            sum += c[i - 1];
+        }
+    }
+
+    qreal c[M - 1];
+    qreal sum;
+};
+
+template <t_WindowShape Shape, int M>
+constexpr t_WindowTable<Shape, M> WindowTable{};
+
+// Largest value of x convolved with the window, at the positions where the
+// whole window fits, divided by the window's sum. With the length fixed, the
+// inner loop can be unrolled and vectorised.
+template <t_WindowShape Shape, int M>
+qreal windowedPeakKernel(const qreal *x, int n)
+{
+    const t_WindowTable<Shape, M> &w = WindowTable<Shape, M>;
+    qreal max_y = 0.;
+    for (int j = 0; j + (M - 1) <= n; j ++)
+    {
+        qreal y = 0.;
+        for (int i = 0; i < M - 1; i ++)
+        {
+            y += w.c[i]*x[j + i];
+        }
+        if (y > max_y)
+        {
+            max_y = y;
+        }
+    }
+    return max_y/w.sum;
+}
+
+// Changing the window works out the windowed maximums of any loaded traces again
+extern void setWindow(t_WindowShape shape, qreal seconds);
+extern t_WindowShape windowShape(void);
+extern qreal windowSeconds(void);
+extern int windowLength(float frequency);
+
+extern qreal windowedPeakOf(const QVector<qreal> &x, float frequency);
+
+#endif // WINDOW_H